@@ -0,0 +1,74 @@
+// ============================================================================
+//
+// decim.h   - compile-time CIC decimator for the I/Q sample clock
+//
+// Decim<D> decimates one channel by D (4, 8, 16 ...) with a cascade of
+// log2(D) third order CIC stages, each (1 + z^-1)^3 followed by a 2:1
+// decimation.  A stage has a gain of 8; the first stage shifts by 1, the
+// middle stages by 3 and the last by 0, so every D has the same overall
+// gain of 32 (10-bit ADC input to +/-16384 out) and no stage overflows
+// 16 bits.
+//
+// put() takes sample n (0..D-1) of a frame.  A stage only runs when its
+// input completes a pair, so the work is spread over the frame and the
+// output is ready when n == D-1.
+//
+// ============================================================================
+
+#include <inttypes.h>
+
+#ifndef DECIM_H
+#define DECIM_H
+
+// one stage: y = (x + 3*x[-1] + 3*x[-2] + x[-3]) >> SH
+template<uint8_t SH>
+struct CIC3 {
+  int16_t v[3];   // last three inputs
+
+  // store an input without computing an output
+  inline void put(int16_t x) {
+    v[2] = v[1];
+    v[1] = v[0];
+    v[0] = x;
+  }
+
+  // store an input and return the output
+  inline int16_t out(int16_t x) {
+    int16_t y = (x + (v[0] + v[1]) * 3 + v[2]) >> SH;
+    put(x);
+    return y;
+  }
+};
+
+// D:1 decimator, returns true with the output in x
+template<uint8_t D, uint8_t SH = 1>
+struct Decim {
+  CIC3<SH> s;
+  Decim<D/2, 3> next;
+
+  inline bool put(int16_t &x, uint8_t n) {
+    if (!(n & 1)) {
+      s.put(x);
+      return false;
+    }
+    x = s.out(x);
+    return next.put(x, n >> 1);
+  }
+};
+
+// last stage
+template<uint8_t SH>
+struct Decim<2, SH> {
+  CIC3<0> s;
+
+  inline bool put(int16_t &x, uint8_t n) {
+    if (!(n & 1)) {
+      s.put(x);
+      return false;
+    }
+    x = s.out(x);
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,92 @@
+
+// ============================================================================
+//
+// fft.cpp   - fixed-point FFT for the bandscope
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "recv.h"
+#include "fft.h"
+
+// sin(2*pi*k/64) in Q15, cos(k) = sin(k+16)
+static const int16_t fft_sin[48] PROGMEM = {
+      0,   3212,   6393,   9512,  12539,  15446,  18204,  20787,
+  23170,  25329,  27245,  28898,  30273,  31356,  32137,  32609,
+  32767,  32609,  32137,  31356,  30273,  28898,  27245,  25329,
+  23170,  20787,  18204,  15446,  12539,   9512,   6393,   3212,
+      0,  -3212,  -6393,  -9512, -12539, -15446, -18204, -20787,
+ -23170, -25329, -27245, -28898, -30273, -31356, -32137, -32609
+};
+
+// Hann window in Q8, w[64-n] = w[n]
+static const uint8_t fft_win[33] PROGMEM = {
+    0,   1,   2,   6,  10,  15,  22,  29,  37,  47,  57,  68,  79,  91, 103, 115,
+  128, 141, 153, 165, 177, 188, 199, 209, 219, 227, 234, 241, 246, 250, 254, 255,
+  255
+};
+
+// reverse the FFT_LOG2 low bits of k
+static uint8_t bitrev(uint8_t k) {
+  uint8_t r = 0;
+  for (uint8_t b = 0; b < FFT_LOG2; b++) {
+    r = (r << 1) | (k & 1);
+    k >>= 1;
+  }
+  return r;
+}
+
+// apply the window (and 1/2 headroom) and put the
+// samples in bit-reversed order
+void fft_window(int16_t *x) {
+  for (uint8_t n = 0; n < FFT_N; n++) {
+    uint8_t w = pgm_read_byte(&fft_win[(n <= FFT_N/2) ? n : FFT_N - n]);
+    x[2*n]   = ((int32_t)x[2*n]   * w) >> 9;
+    x[2*n+1] = ((int32_t)x[2*n+1] * w) >> 9;
+  }
+  for (uint8_t n = 0; n < FFT_N; n++) {
+    uint8_t r = bitrev(n);
+    if (r > n) {
+      int16_t t;
+      t = x[2*n];   x[2*n]   = x[2*r];   x[2*r]   = t;
+      t = x[2*n+1]; x[2*n+1] = x[2*r+1]; x[2*r+1] = t;
+    }
+  }
+}
+
+// one decimation-in-time stage, scaled by 1/2
+// with the 1/2 input headroom the sums stay within 16 bits
+void fft_stage(int16_t *x, uint8_t s) {
+  uint8_t half = 1 << s;
+  uint8_t tstep = (FFT_N/2) >> s;
+  for (uint8_t j = 0; j < half; j++) {
+    int16_t wr =  pgm_read_word(&fft_sin[j*tstep + FFT_N/4]);  // cos
+    int16_t wi = -pgm_read_word(&fft_sin[j*tstep]);            // -sin
+    for (uint8_t a = j; a < FFT_N; a += 2*half) {
+      int16_t *pa = &x[2*a];
+      int16_t *pb = &x[2*(a + half)];
+      int16_t tr = ((int32_t)wr * pb[0] - (int32_t)wi * pb[1]) >> 15;
+      int16_t ti = ((int32_t)wr * pb[1] + (int32_t)wi * pb[0]) >> 15;
+      pb[0] = (pa[0] - tr) >> 1;
+      pb[1] = (pa[1] - ti) >> 1;
+      pa[0] = (pa[0] + tr) >> 1;
+      pa[1] = (pa[1] + ti) >> 1;
+    }
+  }
+}
+
+// complete FFT
+void fft_run(int16_t *x) {
+  fft_window(x);
+  for (uint8_t s = 0; s < FFT_LOG2; s++) fft_stage(x, s);
+}
+
+// level of bin k: 16*log2 |X[k]|
+// magnitude from max + 3/8 min (within 0.6dB)
+uint8_t fft_level(const int16_t *x, uint8_t k) {
+  uint16_t re = abs(x[2*k]);
+  uint16_t im = abs(x[2*k+1]);
+  uint16_t mag = (re > im) ? re + ((im * 3) >> 3) : im + ((re * 3) >> 3);
+  return log2q4(mag);
+}
@@ -0,0 +1,26 @@
+// ============================================================================
+//
+// filters.h   - bandwidth filter coefficient sets
+//
+// BW1500..BWFULL calculated by WinFilter
+// BW1000 and the CW filters are Hamming windowed designs,
+// the CW filters centered between the 600 and 700 Hz tones
+// the long CW filters use the hardware multiplier
+//
+// ============================================================================
+
+#include <inttypes.h>
+#include "fir.h"
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+typedef FIR<0x006, -0x026, -0x074, 0x01a, 0x470, 0x810> fir1500;
+typedef FIR<0x003, 0x028, -0x03a, -0x114, 0x430, 0x9e0> fir2000;
+typedef FIR<-0x018, -0x004, 0x090, -0x1e0, 0x390, 0xbc0> fir2500;
+typedef FIR<0x0a8, -0x0b8, 0x0c6, -0x0d2, 0x0da, 0xe80> firfull;
+typedef FIR<-32, -87, 1, 434, 1054, 1357> fir1000;
+typedef FIRMac<28, -1, -75, -196, -317, -359, -255, 2, 336, 620, 731> fircw500;
+typedef FIRMac<0, 23, 57, 91, 107, 80, -2, -127, -258, -343, -333, -211, 1, 240, 427, 498> fircw300;
+
+#endif
@@ -0,0 +1,182 @@
+
+// ============================================================================
+//
+// fir.h   - compile-time shift-add FIR filter generator
+//
+// FIR<c0, c1, ... cm> is a symmetric FIR filter with 2m+1 taps.
+// c0 multiplies the outer tap pair x[0]+x[2m], cm the centre tap x[m].
+// Every coefficient is converted to canonical signed digit (CSD) form
+// at compile time, and the products are summed one bit-plane at a time
+// (Horner form), so a kernel costs one add per non-zero CSD digit plus
+// one 1-bit shift per bit-plane.  There are no multiplies.
+//
+// FIRMac<c0, c1, ... cm> is the same filter computed with the hardware
+// multiplier: the tap pairs are folded to 16 bits and multiplied with a
+// coefficient table in flash.  This is cheaper than shift-add for long
+// (21 taps and up) filters.  The folded pairs must fit in 16 bits, so
+// the input must stay within +/-16383.
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#ifndef FIR_H
+#define FIR_H
+
+// least significant CSD digit of c: -1, 0 or +1
+constexpr int8_t csd_lsd(int32_t c) {
+  return (c & 1) ? 2 - (c & 3) : 0;
+}
+
+// CSD digit of c at bit b
+constexpr int8_t csd_digit(int32_t c, int8_t b) {
+  return b ? csd_digit((c - csd_lsd(c)) / 2, b - 1) : csd_lsd(c);
+}
+
+// position of the highest non-zero CSD digit of c (-1 if c is zero)
+constexpr int8_t csd_top(int32_t c) {
+  return c ? 1 + csd_top((c - csd_lsd(c)) / 2) : -1;
+}
+
+constexpr int8_t csd_max(int8_t a, int8_t b) {
+  return (a > b) ? a : b;
+}
+
+// highest CSD digit over a coefficient list
+template<int16_t... C> struct FIRTop;
+
+template<int16_t C0, int16_t... C> struct FIRTop<C0, C...> {
+  static constexpr int8_t value = csd_max(csd_top(C0), FIRTop<C...>::value);
+};
+
+template<> struct FIRTop<> {
+  static constexpr int8_t value = -1;
+};
+
+// add bit-plane B of the coefficients (from tap pair K on)
+template<int8_t B, uint8_t K, int16_t... C> struct FIRPlane;
+
+template<int8_t B, uint8_t K, int16_t C0, int16_t... C> struct FIRPlane<B, K, C0, C...> {
+  static inline void add(int32_t &y, const int32_t *t) {
+    if (csd_digit(C0, B) > 0) y += t[K];
+    if (csd_digit(C0, B) < 0) y -= t[K];
+    FIRPlane<B, K+1, C...>::add(y, t);
+  }
+};
+
+template<int8_t B, uint8_t K> struct FIRPlane<B, K> {
+  static inline void add(int32_t &y, const int32_t *t) {}
+};
+
+// sum bit-planes TOP..B in Horner form
+template<int8_t B, bool END, int16_t... C> struct FIRHorner {
+  static inline void run(int32_t &y, const int32_t *t) {
+    FIRHorner<B+1, (B+1 > FIRTop<C...>::value), C...>::run(y, t);
+    y <<= 1;
+    FIRPlane<B, 0, C...>::add(y, t);
+  }
+};
+
+template<int8_t B, int16_t... C> struct FIRHorner<B, true, C...> {
+  static inline void run(int32_t &y, const int32_t *t) {}
+};
+
+// symmetric FIR kernel
+// x[k] is the sample k steps ago, the result is y >> gain
+template<int16_t... C> struct FIR {
+  static const uint8_t M = sizeof...(C) - 1;   // centre tap
+  static const uint8_t NTAPS = 2*M + 1;
+  static const int16_t coef[M+1];              // for reference models only
+
+  static int16_t run(const int16_t *x, uint8_t gain) {
+    int32_t t[M+1];
+    // fold the symmetric tap pairs
+    for (uint8_t k = 0; k < M; k++) t[k] = (int32_t)x[k] + x[NTAPS-1-k];
+    t[M] = x[M];
+    int32_t y = 0;
+    FIRHorner<0, (0 > FIRTop<C...>::value), C...>::run(y, t);
+    return y >> gain;
+  }
+};
+
+template<int16_t... C> const int16_t FIR<C...>::coef[] PROGMEM = { C... };
+
+// 16x16 -> 32 bit signed multiply-accumulate
+// a and b in r16..r23 for muls/mulsu, r0 and r1 are clobbered by the
+// multiplies and r1 is cleared again (tools: make mac-check)
+#ifdef __AVR__
+inline void mac16(int32_t &acc, int16_t a, int16_t b) {
+  uint8_t z;
+  asm volatile(
+    "clr   %[z]            \n\t"
+    "muls  %B[a], %B[b]    \n\t"  // ah * bh
+    "add   %C[acc], r0     \n\t"
+    "adc   %D[acc], r1     \n\t"
+    "mul   %A[a], %A[b]    \n\t"  // al * bl
+    "add   %A[acc], r0     \n\t"
+    "adc   %B[acc], r1     \n\t"
+    "adc   %C[acc], %[z]   \n\t"
+    "adc   %D[acc], %[z]   \n\t"
+    "mulsu %B[a], %A[b]    \n\t"  // ah * bl
+    "sbc   %D[acc], %[z]   \n\t"  // sign extend
+    "add   %B[acc], r0     \n\t"
+    "adc   %C[acc], r1     \n\t"
+    "adc   %D[acc], %[z]   \n\t"
+    "mulsu %B[b], %A[a]    \n\t"  // bh * al
+    "sbc   %D[acc], %[z]   \n\t"  // sign extend
+    "add   %B[acc], r0     \n\t"
+    "adc   %C[acc], r1     \n\t"
+    "adc   %D[acc], %[z]   \n\t"
+    "clr   r1              \n\t"  // restore the zero register
+    : [acc] "+r" (acc), [z] "=&r" (z)
+    : [a] "a" (a), [b] "a" (b)
+    : "r0"
+  );
+}
+#else
+inline void mac16(int32_t &acc, int16_t a, int16_t b) {
+  acc += (int32_t)a * b;
+}
+#endif
+
+// symmetric FIR multiply-accumulate kernel, C reference
+// c[] (in flash) holds the m+1 coefficients from the outer pair to
+// the centre tap, x[k] is the sample k steps ago
+inline int16_t fir_mac_ref(const int16_t *x, const int16_t *c, uint8_t m, uint8_t gain) {
+  int32_t y = 0;
+  for (uint8_t k = 0; k < m; k++) {
+    int16_t t = (uint16_t)x[k] + (uint16_t)x[2*m-k];  // fold the tap pair
+    y += (int32_t)t * (int16_t)pgm_read_word(&c[k]);
+  }
+  y += (int32_t)x[m] * (int16_t)pgm_read_word(&c[m]);
+  return y >> gain;
+}
+
+// symmetric FIR multiply-accumulate kernel
+// same result as fir_mac_ref(), with the AVR multiplier
+inline int16_t fir_mac(const int16_t *x, const int16_t *c, uint8_t m, uint8_t gain) {
+  const int16_t *xr = x + 2*m;
+  int32_t y = 0;
+  for (uint8_t k = 0; k < m; k++) {
+    int16_t t = (uint16_t)*x++ + (uint16_t)*xr--;  // fold the tap pair
+    mac16(y, t, pgm_read_word(c++));
+  }
+  mac16(y, *x, pgm_read_word(c));
+  return y >> gain;
+}
+
+// symmetric FIR kernel with the hardware multiplier
+template<int16_t... C> struct FIRMac {
+  static const uint8_t M = sizeof...(C) - 1;   // centre tap
+  static const uint8_t NTAPS = 2*M + 1;
+  static const int16_t coef[M+1];
+
+  static int16_t run(const int16_t *x, uint8_t gain) {
+    return fir_mac(x, coef, M, gain);
+  }
+};
+
+template<int16_t... C> const int16_t FIRMac<C...>::coef[] PROGMEM = { C... };
+
+#endif
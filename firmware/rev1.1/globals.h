@@ -46,11 +46,52 @@
 #define BW2000  1
 #define BW2500  2
 #define BWFULL  3
+#define BW1000  4
+#define BWCW500 5
+#define BWCW300 6
 
 // agc modes
 #define FAST  1
 #define SLOW  2
+#define LOOK  3   // fast, look-ahead detector
 
+// I/Q balance modes
+#define IQ_AUTO  1   // adapt the correction
+#define IQ_HOLD  2   // keep the current correction
+
+// DAC output modes: CIC interpolator order and noise shaper order
+#define DAC_CIC2     0   // 2nd order CIC, truncated
+#define DAC_CIC2NS1  1   // 2nd order CIC, 1st order noise shaping
+#define DAC_CIC2NS2  2   // 2nd order CIC, 2nd order noise shaping
+#define DAC_CIC3     3   // 3rd order CIC (DSP_DECIM 4), truncated
+#define DAC_CIC3NS1  4   // 3rd order CIC, 1st order noise shaping
+#define DAC_CIC3NS2  5   // 3rd order CIC, 2nd order noise shaping
+
+// DSP pipeline modes
+#define DSP_SAMPLE  0   // all processing in the sample clock ISR
+#define DSP_BLOCK   1   // ISR captures blocks, processed at low priority
+
+#ifndef DSP_MODE
+#define DSP_MODE  DSP_SAMPLE
+#endif
+
+// sample clock and decimation
+// the ADC alternates I and Q, so each channel is sampled at ADC_RATE/2
+// and decimated by DSP_DECIM (4 or 8) to the audio rate; at 16 the
+// in-band noise sits on the fixed-point floor of the filters (ref-check
+// noise SNR under 20 dB), for a narrow audio band lower ADC_RATE instead
+#ifndef ADC_RATE
+#define ADC_RATE   62500   // interleaved I/Q sample clock (Hz)
+#endif
+#ifndef DSP_DECIM
+#define DSP_DECIM  4       // I/Q decimation ratio
+#endif
+#define AUDIO_RATE  (ADC_RATE / 2 / DSP_DECIM)
+
+// ISR profiling (prof.h, CAT PR command)
+#ifndef ISR_PROF
+#define ISR_PROF  0
+#endif
 
 #endif
 
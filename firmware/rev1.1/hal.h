@@ -0,0 +1,96 @@
+
+// ============================================================================
+//
+// hal.h   - hardware abstraction for the receiver DSP chain
+//
+// On the AVR target these are inline register accesses.
+// On a host build (no __AVR__) they are implemented in tools/hal_host.cpp
+// so that recv.cpp can be built and run as a plain Linux library.
+//
+// ============================================================================
+
+#include <inttypes.h>
+#include "globals.h"
+
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef __AVR__
+
+#include <Arduino.h>
+
+// init ADC
+inline void hal_init_adc() {
+  DIDR0 |= 0xc0; // disable digital input for ADC6 and ADC7
+  ADCSRA = 0x84; // ADEN=0x80 ADPS=0x04 (divide by 16)
+  ADCSRB = 0;    // enable with prescaler
+}
+
+// init DAC
+inline void hal_init_dac() {
+  TCCR1A = (1 << WGM11);
+  TCCR1B = (1 << CS10) | (1 << WGM13) | (1 << WGM12); // Mode 14 - Fast PWM
+}
+
+// enable/disable DAC audio
+inline void hal_dac_enable(bool val) {
+  if (val) {
+    TCCR1A |= (1 << COM1A1);
+    pinMode(TONE, OUTPUT);
+  } else {
+    pinMode(TONE, INPUT);
+    TCCR1A &= ~(1 << COM1A1);
+  }
+}
+
+// set PWM top value
+inline void hal_dac_top(uint8_t top) {
+  ICR1L = top;
+  ICR1H = 0x00;
+}
+
+// start timer2 ADC sample clock
+inline void hal_adc_timer(uint8_t ocr) {
+  ASSR &= ~(1 << AS2);               // timer2 clocked by the I/O clock
+  TCNT2 = 0;                         // clear the counter
+  TCCR2A = (1 << WGM21);             // mode 2 - clear on compare match
+  TCCR2B = (1 << CS22);              // 64 prescaler
+  OCR2A = ocr;
+  TIMSK2 |= (1 << OCIE2A);           // enable TIMER2_COMPA interrupt
+}
+
+// simulator builds (tools/isr_bench.cpp) read the conversion result
+// from a variable they fill, two lds as for the ADC register
+#ifdef HAL_ADC_SIM
+extern volatile uint16_t hal_adc_sim;
+#define HAL_ADC_RESULT  hal_adc_sim
+#else
+#define HAL_ADC_RESULT  ADC
+#endif
+
+// select the next ADC input, start a conversion
+// and return the result of the previous conversion
+inline uint16_t hal_adc_read(uint8_t adcpin) {
+  ADMUX = (adcpin - 14) | (1 << REFS1) | (1 << REFS0);
+  ADCSRA |= (1 << ADSC);
+  return HAL_ADC_RESULT;
+}
+
+// load the PWM DAC
+inline void hal_dac_write(uint8_t val) {
+  OCR1AL = val;
+}
+
+#else
+
+void hal_init_adc();
+void hal_init_dac();
+void hal_dac_enable(bool);
+void hal_dac_top(uint8_t);
+void hal_adc_timer(uint8_t);
+uint16_t hal_adc_read(uint8_t);
+void hal_dac_write(uint8_t);
+
+#endif
+
+#endif
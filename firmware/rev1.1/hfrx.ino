@@ -10,6 +10,8 @@
 // i2c0.h               - I2C library
 // i2c1.h               - I2C library
 // recv.h               - SSB receiver library
+// fft.h                - bandscope FFT
+// scan.h               - band scanner
 // oled.h               - OLED library
 // font.h               - OLED font
 // lcd.h                - LCD library (optional)
@@ -69,6 +71,9 @@
 #include "oled.h"
 #include "font.h"
 #include "si5351.h"
+#include "fft.h"
+#include "scan.h"
+#include "prof.h"
 
 // prototype defs
 char getc();
@@ -76,8 +81,8 @@ char gnac();
 void getsemi();
 char gcal(char ch);
 uint8_t len(char *str);
-void send(char *str);
-uint8_t cmpstr(char *dst, char *src);
+void send(const __FlashStringHelper *str);
+uint8_t cmpstr(char *dst, const char *src);
 void catstr(char *dst, char c);
 void uppercase(char *str);
 uint8_t alpha(char ch);
@@ -93,6 +98,7 @@ void show_info();
 void show_debug();
 void print_version();
 void update_display();
+void show_mode();
 char* int2str(uint8_t val);
 char* freq2str(uint32_t val);
 void wait_ms(uint16_t dly);
@@ -100,16 +106,29 @@ void wait_us(uint16_t x);
 void blinkLED();
 void stepsize_cursor();
 void CAT_VFO();
+void CAT_num(uint32_t val, uint8_t n);
+uint32_t getnum(uint8_t n);
 void CAT_cmd();
 void reset_xtimer();
 void check_timeout();
+void check_smeter();
+void check_scope();
+void draw_scope(uint8_t page);
+uint8_t scan_height(uint8_t c);
+void check_scan();
+void scan_start();
+void show_scan();
+uint8_t smeter_units();
 void check_UI();
 void check_menu();
 void exit_menu();
 void update_freq(uint8_t x);
+void tune_vfo(int32_t f);
+void set_rit(int32_t ofs);
 void lock_encoder();
 void menuAction(uint8_t id);
-void paramAction(uint8_t id, uint8_t* ptr, const char* sap[], uint8_t min, uint8_t max);
+void paramAction(uint8_t id, uint8_t* ptr, const char* sap, uint8_t min, uint8_t max);
+char* get_item(const char* str, uint8_t k);
 void get_label(uint8_t id, const char* str);
 void show_label(uint8_t id);
 void do_reset(uint8_t soft);
@@ -141,6 +160,10 @@ void init_recv();
 #define AGC_ADDR    37       // agc
 #define TONE_ADDR   38       // CW tone
 #define DXBK_ADDR   39       // display blanking (on/off)
+#define SCOP_ADDR   40       // bandscope (on/off)
+#define IQBL_ADDR   41       // I/Q balance mode
+#define IQ_ADDR     42       // I/Q balance coefficients
+#define DACM_ADDR   46       // DAC output mode
 
 // class instantiation
 EE      eeprom;
@@ -149,6 +172,7 @@ I2C1    i2c1;
 RECV    recv;
 OLED    oled;
 SI5351  si5351;
+SCAN    scan;
 
 #define F_XTAL  27000000UL
 #define F_CPU   20000000UL
@@ -183,6 +207,12 @@ SI5351  si5351;
 #define TWO_MINUTES    120000
 #define FIVE_MINUTES   600000
 #define HALF_HOUR     3600000
+#define SMETER_MS         250    // S-meter display refresh
+
+// S-meter
+#define SM_S9       -50    // S9 level in dB re. ADC full scale (uncalibrated)
+#define SM_COL       80    // S-meter bar position and width
+#define SM_WIDTH     48
 
 // user interface buttons
 #define NBP          0  // no-button-pushed
@@ -211,11 +241,16 @@ uint16_t ct[] = {600, 700};
 #define STEP_10K  5
 #define STEP_100K 6
 #define STEP_1M   7
+#define STEP_RIT  STEP_0   // the encoder tunes the RIT offset
 
 uint32_t stepsizes[] = { 0, 1, 10, 100, 1000, 10000, 100000, 1000000 };
 
 #define INIT_FREQ  14100000UL
 
+// RIT offset
+#define RIT_MAX    9999    // Hz
+#define RIT_STEP     10    // Hz per encoder step
+
 // menu id values
 #define VOLUME      0
 #define RADIOMODE   1
@@ -226,14 +261,24 @@ uint32_t stepsizes[] = { 0, 1, 10, 100, 1000, 10000, 100000, 1000000 };
 #define AGC         6
 #define CWTONE      7
 #define DXBLANK     8
-#define CALIBRATE   9
-#define SAVE2EE     10
-#define RESET       11
-#define SWVER       12
+#define SCOPE       9
+#define SCANNER     10
+#define RIT         11
+#define IQBAL       12
+#define DACMODE     13
+#define CALIBRATE   14
+#define SAVE2EE     15
+#define RESET       16
+#define SWVER       17
 
 #define FIRSTMENU  VOLUME
 #define LASTMENU   SWVER
 
+// scan modes
+#define SCAN_BAND   1   // the current band, SCAN_N channels
+#define SCAN_LIST   2   // the band frequencies
+#define SCAN_RANGE  3   // start, step and channels from CAT SS
+
 // globals
 uint8_t  DEBUG = FALSE;
 int32_t  vfofreq  = INIT_FREQ;
@@ -250,10 +295,35 @@ volatile uint8_t rxstate = 0;
 uint8_t  display = ON;
 uint32_t xtimer;
 
+// for the S-meter display
+uint32_t smtimer;
+uint8_t  smbar = 0xff;
+
+// for the bandscope
+// I/Q capture, transformed in place, then the column heights (SCOPE_H);
+// the scanner's level table while a scan runs
+int16_t  scope_buf[2*FFT_N];
+uint8_t  scope_step = 0;      // bandscope task state
+
+// for the band scanner
+uint8_t  scan_cur  = OFF;     // scan mode running
+uint8_t  scan_page = 0xff;    // bar graph page to draw next
+int32_t  scan_f0   = 0;       // CAT SS range
+int32_t  scan_step = 0;
+uint8_t  scan_n    = SCAN_N;
+uint16_t scan_dwell = 0;      // least time per channel (ms)
+extern const int32_t bandfreq[];
+extern const int32_t bandedge[] PROGMEM;
+
+// for RIT: the dial stays at vfofreq, the VFO goes to vfofreq + rit_ofs
+int16_t  rit_ofs   = 0;       // RIT offset (Hz)
+uint8_t  xit       = OFF;     // XIT (CAT only, receive-only radio)
+int32_t  vfo_dial  = 0;       // dial frequency of the last tune_vfo()
+
 // menu labels
-const char mlabel[] = "\
+const char mlabel[] PROGMEM = "\
 Volume|Radio Mode|Radio Band|Filter|Rx Attn|Dig Attn|\
-AGC|CW Tone|OLED Timeout|Calibrate|Save to EE|Factory Reset|Version|";
+AGC|CW Tone|OLED Timeout|Scope|Scan|RIT|IQ Balance|DAC Mode|Calibrate|Save to EE|Factory Reset|Version|";
 
 // menu variables
 uint8_t  stepsize   = STEP_1K;   // freq tuning step size
@@ -268,22 +338,35 @@ uint8_t  dg_attn    = 4;         // digital attenuation
 uint8_t  agc        = OFF;       // auto gain control
 uint8_t  cwtone     = T600;      // CW tone select
 uint8_t  dxblank    = ON;        // display blanking
-
-const char* band_label[]   = { "80M", "60M", "40M", "30M", "20M", "17M", "15M", "12M", "10M" };
-const char* mode_label[]   = { "USB", "LSB", "CW"};
-const char* filtbw_label[] = { "1500", "2000", "2500", "FULL" };
-const char* cwtone_label[] = { "600", "700" };
-const char* dxbk_label[]   = { "OFF", "5 Minutes", "30 Minutes"};
-const char* onoff_label[]  = { "OFF", "ON" };
-const char* rxatt_label[]  = { "OFF", "-6dB" };
-const char* dgatt_label[]  = { "-36dB", "-30dB", "-24dB", "-18dB", "-12dB", "-6dB", "OFF" };
+uint8_t  scope      = OFF;       // bandscope
+uint8_t  scanmode   = OFF;       // band scanner
+uint8_t  rit        = OFF;       // RIT
+uint8_t  iqbal      = OFF;       // I/Q balance
+uint8_t  dacmode    = DAC_CIC2;  // DAC interpolator / noise shaper
+
+// value labels, read with get_item()
+const char band_label[]   PROGMEM = "80M|60M|40M|30M|20M|17M|15M|12M|10M|";
+const char mode_label[]   PROGMEM = "USB|LSB|CW|";
+const char mdcode[]               = { '2', '1', '3' };  // CAT mode codes
+const char filtbw_label[] PROGMEM = "1500|2000|2500|FULL|1000|CW500|CW300|";
+const char cwtone_label[] PROGMEM = "600|700|";
+const char dxbk_label[]   PROGMEM = "OFF|5 Minutes|30 Minutes|";
+const char onoff_label[]  PROGMEM = "OFF|ON|";
+const char scan_label[]   PROGMEM = "OFF|BAND|LIST|RANGE|";
+const char agc_label[]    PROGMEM = "OFF|FAST|SLOW|LOOK|";
+const char iqbal_label[]  PROGMEM = "OFF|AUTO|HOLD|";
+const char dac_label[]    PROGMEM = "CIC2|CIC2 NS1|CIC2 NS2|CIC3|CIC3 NS1|CIC3 NS2|";
+const char rxatt_label[]  PROGMEM = "OFF|-6dB|";
+const char dgatt_label[]  PROGMEM = "-36dB|-30dB|-24dB|-18dB|-12dB|-6dB|OFF|";
 
 // millisecond time
 volatile uint32_t msTimer = 0;
 
 // timer 0 interrupt service routine
 ISR(TIMER0_COMPA_vect) {
+  PROF_SHORT_ENTER();
   msTimer++;
+  PROF_SHORT_EXIT(ms_max);
 }
 
 // rotary encoder variables
@@ -306,19 +389,28 @@ inline void enc() {
 
 // rotary encoder interrupt handler (A)
 ISR(PCINT2_vect) {
+  PROF_SHORT_ENTER();
   enc_a = digitalRead(ROTA);
   enc();
+  PROF_SHORT_EXIT(enc_max);
 }
 
 // rotary encoder interrupt handler (B)
 ISR(PCINT0_vect) {
+  PROF_SHORT_ENTER();
   enc_b = digitalRead(ROTB);
   enc();
+  PROF_SHORT_EXIT(enc_max);
 }
 
 // ADC sample clock interrupt
 ISR(TIMER2_COMPA_vect) {
+  PROF_ENTER(rxstate);
   recv.sample_dsp();
+  PROF_EXIT();
+#if DSP_MODE == DSP_BLOCK
+  recv.process_blocks();  // re-enables interrupts while it runs
+#endif
 }
 
 // read char from the serial port
@@ -378,14 +470,14 @@ uint8_t len(char *str) {
 }
 
 // send a command
-void send(char *str) {
+void send(const __FlashStringHelper *str) {
   getsemi(); // get semicolon
   Serial.print(str);
 }
 
-// compare command
-uint8_t cmpstr(char *x, char *y) {
-  if ((x[0] == y[0]) && (x[1] == y[1])) return(1);
+// compare command (y in PROGMEM)
+uint8_t cmpstr(char *x, const char *y) {
+  if ((x[0] == pgm_read_byte(&y[0])) && (x[1] == pgm_read_byte(&y[1]))) return(1);
   else return(0);
 }
 
@@ -445,20 +537,33 @@ void cat(char *dst, char *src) {
 // display the firmware version
 void show_version() {
   oled.clrScreen();
-  oled.printline(0, "SSB Receiver");
-  oled.printline(1, VERSION);
+  oled.printline(0, F("SSB Receiver"));
+  oled.printline(1, F(VERSION));
   print_version();
   wait_ms(TWO_SECONDS);
   update_display();
 }
 
+#if ISR_PROF
+#define HELP_PROF "  PR => ISR profile\r\n"
+#else
+#define HELP_PROF ""
+#endif
+
 #define HELP_MSG "\r\n\
   IF  G -  radio status\r\n\
   ID  G -  radio ID\r\n\
   FA  G S  frequency\r\n\
   AI  G S  auto-information\r\n\
   MD  G S  radio mode\r\n\
+  SM  G -  S-meter (0000..0030)\r\n\
+  GT  G S  AGC (000=OFF 001=LOOK 005=FAST 020=SLOW)\r\n\
   PS  G S  power-on status\r\n\
+  SC  G S  scan (0=OFF 1=BAND 2=LIST 3=RANGE)\r\n\
+  RT  G S  RIT status\r\n\
+  RC  - S  RIT clear\r\n\
+  RU  - S  RIT up (00000..09999 Hz, default 10)\r\n\
+  RD  - S  RIT down\r\n\
   XT  G S  XIT status\r\n\
   TX  - S  transmit\r\n\
   RX  - S  receive\r\n\n\
@@ -466,12 +571,14 @@ void show_version() {
   HH => print help\r\n\
   DD => debug on/off\r\n\
   II => print info\r\n\
+  SS => scan range and dwell\r\n\
+  SD => print scan levels\r\n\
   FR => factory reset\r\n\
-  SR => soft reset\r\n\n"
+  SR => soft reset\r\n" HELP_PROF "\n"
 
 // print help message
 void show_help() {
-  Serial.print(HELP_MSG);
+  Serial.print(F(HELP_MSG));
 }
 
 // print xtal calibration value
@@ -483,7 +590,7 @@ void show_fxtal() {
 // print calibration step
 void show_cal(int16_t step) {
   oled.clrLine(0);
-  oled.putstr("Cal step=");
+  oled.putstr(F("Cal step="));
   oled.setCursor(11, 0);
   oled.print16(step);
 }
@@ -492,41 +599,86 @@ void show_cal(int16_t step) {
 void show_info() {
   print_version();
   // print band
-  Serial.print("band = ");
-  Serial.println(band_label[radioband]);
+  Serial.print(F("band = "));
+  Serial.println(get_item(band_label, radioband));
   // print frequency
-  Serial.print("freq = ");
+  Serial.print(F("freq = "));
   Serial.print(vfofreq);
-  Serial.print("\r\n");
+  Serial.print(F("\r\n"));
   // print mode
-  Serial.print("mode = ");
-  Serial.println(mode_label[radiomode]);
+  Serial.print(F("mode = "));
+  Serial.println(get_item(mode_label, radiomode));
+  // print RIT
+  Serial.print(F("rit = "));
+  Serial.print(get_item(onoff_label, rit));
+  Serial.print(' ');
+  Serial.println(rit_ofs);
+  // print I/Q balance
+  int16_t p, g;
+  recv.iq_get(&p, &g);
+  Serial.print(F("iq gain/phase = "));
+  Serial.print(g);
+  Serial.print('/');
+  Serial.println(p);
+  // print the si5351 register bytes written and sent
+  Serial.print(F("si5351 bytes = "));
+  Serial.print(si5351.req_bytes);
+  Serial.print('/');
+  Serial.println(si5351.sent_bytes);
+#if DSP_MODE == DSP_BLOCK
+  // print DSP block counters
+  Serial.print(F("underruns = "));
+  Serial.println(recv.underruns);
+  Serial.print(F("overruns = "));
+  Serial.println(recv.overruns);
+#endif
 }
 
 // show debug status
 void show_debug() {
   DEBUG = ! DEBUG;
-  Serial.print("DEBUG=");
+  Serial.print(F("DEBUG="));
   Serial.print(DEBUG);
-  Serial.println("");
+  Serial.println();
 }
 
 // print the firmware version to serial port
 void print_version() {
   Serial.println('\n');
-  Serial.println(VERSION);
-  Serial.println(DATE);
+  Serial.println(F(VERSION));
+  Serial.println(F(DATE));
 }
 
 // update display with mode/band and vfo frequency
 void update_display() {
   oled.clrScreen();
+  smbar = 0xff;  // redraw the S-meter
+  show_mode();
+  update_freq(0);
+}
+
+// print mode and band on line 0, or mode and RIT offset
+// while RIT is on or the encoder tunes it
+void show_mode() {
+  if (scope) return;
   char tmp[20];
-  cpy(tmp, mode_label[radiomode]);
-  cat(tmp, "   ");
-  cat(tmp, band_label[radioband]);
+  cpy(tmp, get_item(mode_label, radiomode));
+  if (rit || (stepsize == STEP_RIT)) {
+    char r[] = " R+0000";
+    uint16_t v = abs(rit_ofs);
+    if (rit_ofs < 0) r[2] = '-';
+    for (uint8_t i = 6; i > 2; i--) {
+      r[i] = "0123456789"[v % 10];
+      v /= 10;
+    }
+    cat(tmp, r);
+  } else {
+    cat(tmp, "   ");
+    cat(tmp, get_item(band_label, radioband));
+    cat(tmp, " ");
+  }
   oled.printline(0, tmp);
-  update_freq(0);
+  smbar = 0xff;  // the text overwrote the S-meter bar, redraw it
 }
 
 // convert 8-bit integer to string
@@ -595,6 +747,7 @@ void stepsize_cursor() {
     case STEP_10K:  oled.setCursor(4,1); break;
     case STEP_100K: oled.setCursor(3,1); break;
     case STEP_1M:   oled.setCursor(1,1); break;
+    case STEP_RIT:  oled.showCursor(OFF); return;  // RIT on line 0
     default:        oled.setCursor(9,1); break;
   }
   oled.showCursor(ON);
@@ -609,9 +762,14 @@ void stepsize_cursor() {
 // ID        G -    radio ID          returns 019 = Kenwood TS-2000
 // FA        G S    frequency         gets or sets the ADX frequency
 // AI        G S    auto-information  returns 0   = OFF
-// MD        G S    radio mode        returns 2   = USB
+// MD        G S    radio mode        1 = LSB, 2 = USB, 3 = CW
 // PS        G S    power-on status   returns 1   = ON
-// XT        G S    XIT status        returns 0   = OFF
+// SC        G S    scan status       0 = OFF, 1 = band, 2 = list, 3 = range
+// RT        G S    RIT status        0 = OFF, 1 = ON
+// RC        - S    RIT clear         sets the RIT offset to 0
+// RU        - S    RIT up            offset + P1 Hz (5 digits, default 10)
+// RD        - S    RIT down          offset - P1 Hz (5 digits, default 10)
+// XT        G S    XIT status        0 = OFF, 1 = ON (reported only)
 // TX        - S    transmit          returns 0 and set TX LED
 // RX        - S    receive           returns 0 and clears TX LED
 //
@@ -620,10 +778,13 @@ void stepsize_cursor() {
 //  HE => print help
 //  HH => print help
 //  II => print info
+//  SS => get or set the scan range and dwell
+//  SD => print the scan levels
 //  DD => turn on/off debug
 //  FR => factory reset
 //  SR => soft reset
 //  CM => calibration mode
+//  PR => print and clear the ISR profile (ISR_PROF builds)
 // ==============================================================
 
 // check for CAT control
@@ -635,11 +796,29 @@ void check_CAT() {
   }
 }
 
+// print an n digit CAT parameter, zero filled
+void CAT_num(uint32_t val, uint8_t n) {
+  uint32_t p = 1;
+  while (--n) p *= 10;
+  for (; p > 1; p /= 10) {
+    if (val < p) Serial.print('0');
+    else break;
+  }
+  Serial.print(val);
+}
+
+// read an n digit CAT parameter
+uint32_t getnum(uint8_t n) {
+  uint32_t val = 0;
+  while (n--) val = (val * 10) + (getc() - '0');
+  return val;
+}
+
 // print (11-bit) VFO frequency
 void CAT_VFO() {
-  if      (vfofreq >= 10000000) Serial.print("000");
-  else if (vfofreq >=  1000000) Serial.print("0000");
-  else                          Serial.print("00000");
+  if      (vfofreq >= 10000000) Serial.print(F("000"));
+  else if (vfofreq >=  1000000) Serial.print(F("0000"));
+  else                          Serial.print(F("00000"));
   Serial.print(vfofreq);
 }
 
@@ -663,28 +842,36 @@ void CAT_cmd() {
   //====================================
   //  IF           // (command)       2
   //  00014074000  // P1 (VF0)       11
-  //  0000         // P2 (step size)  4
-  //  +00000       // P3 (rit)        6
-  //  00000        // P4->P7          5
+  //  00000        // P2 (step size)  5
+  //  +0000        // P3 (rit offset) 5
+  //  0/1          // P4 (rit on)     1
+  //  0/1          // P5 (xit on)     1
+  //  000          // P6->P7 (memory) 3
   //  0/1          // P8 (Tx/Rx)      1
   //  20000000     // P9->P15         8
   //                       TOTAL  =  37
   //====================================
 
   // get frequency and other status
-  if (cmpstr(cmd, "IF")) {
-    send("IF");
+  if (cmpstr(cmd, PSTR("IF"))) {
+    send(F("IF"));
     CAT_VFO();
-    Serial.print("00000+000000000");
+    Serial.print(F("00000"));
+    Serial.print((rit_ofs < 0) ? '-' : '+');
+    CAT_num(abs(rit_ofs), 4);  // RIT_MAX 9999
+    Serial.print(rit);
+    Serial.print(xit);
+    Serial.print(F("000"));
     Serial.print('0'); // always rx
-    Serial.print("20000000;");
+    Serial.print(mdcode[radiomode]);
+    Serial.print(F("0000000;"));
   }
 
   // get radio ID
-  else if (cmpstr(cmd, "ID")) send("ID019;");
+  else if (cmpstr(cmd, PSTR("ID"))) send(F("ID019;"));
 
   // get or set frequency
-  else if (cmpstr(cmd, "FA")) {
+  else if (cmpstr(cmd, PSTR("FA"))) {
     ch = getc();
     if (numeric(ch)) {
       // set frequency
@@ -696,27 +883,72 @@ void CAT_cmd() {
       getsemi(); // get semicolon
     } else {
       // get frequency
-      Serial.print("FA");
+      Serial.print(F("FA"));
       CAT_VFO();
-      Serial.print(";");
+      Serial.print(';');
     }
   }
 
   // get or set the radio mode
-  else if (cmpstr(cmd, "MD")) {
+  else if (cmpstr(cmd, PSTR("MD"))) {
     ch = getc();
     if (numeric(ch)) {
       // set radio mode
-      // does nothing .. always 2
+      // 1=LSB 2=USB 3=CW
       getsemi();
+      switch (ch) {
+        case '1': radiomode = LSB; break;
+        case '2': radiomode = USB; break;
+        case '3': radiomode = CW;  break;
+        default: break;
+      }
+      recv.configure();
+      update_display();
     } else {
-      // get auto-information status
-      Serial.print("MD2;");
+      // get radio mode
+      Serial.print(F("MD"));
+      Serial.print(mdcode[radiomode]);
+      Serial.print(';');
+    }
+  }
+
+  // get or set the AGC time constant
+  else if (cmpstr(cmd, PSTR("GT"))) {
+    ch = getc();
+    if (numeric(ch)) {
+      // set AGC
+      // 000=OFF 001..004=LOOK 005..009=FAST 010..020=SLOW
+      uint8_t gt = ch - '0';
+      gt = (gt * 10) + (getc() - '0');
+      gt = (gt * 10) + (getc() - '0');
+      getsemi();
+      if (gt == 0) agc = OFF;
+      else if (gt < 5) agc = LOOK;
+      else if (gt < 10) agc = FAST;
+      else agc = SLOW;
+      recv.configure();
+    } else {
+      // get AGC
+      Serial.print(F("GT"));
+      if (agc == LOOK) Serial.print(F("001;"));
+      else if (agc == FAST) Serial.print(F("005;"));
+      else if (agc == SLOW) Serial.print(F("020;"));
+      else Serial.print(F("000;"));
     }
   }
 
+  // get the S-meter reading
+  else if (cmpstr(cmd, PSTR("SM"))) {
+    getsemi();
+    uint8_t v = smeter_units();
+    Serial.print(F("SM000"));
+    if (v < 10) Serial.print('0');
+    Serial.print(v);
+    Serial.print(';');
+  }
+
   // get or set auto-information status
-  else if (cmpstr(cmd, "AI")) {
+  else if (cmpstr(cmd, PSTR("AI"))) {
     ch = getc();
     if (numeric(ch)) {
       // set auto-information status
@@ -724,12 +956,12 @@ void CAT_cmd() {
       getsemi();
     } else {
       // get auto-information status
-      Serial.print("AI0;");
+      Serial.print(F("AI0;"));
     }
   }
 
   // get or set the power (ON/OFF) status
-  else if (cmpstr(cmd, "PS")) {
+  else if (cmpstr(cmd, PSTR("PS"))) {
     ch = getc();
     if (numeric(ch)) {
       // set power (ON/OFF) status
@@ -737,30 +969,83 @@ void CAT_cmd() {
       getsemi();
     } else {
       // get power (ON/OFF) status
-      Serial.print("PS1;");
+      Serial.print(F("PS1;"));
+    }
+  }
+
+  // get or set the RIT (ON/OFF) status
+  else if (cmpstr(cmd, PSTR("RT"))) {
+    ch = getc();
+    if (numeric(ch)) {
+      // set RIT (ON/OFF) status
+      getsemi();
+      rit = (ch == '1');
+      set_rit(rit_ofs);
+    } else {
+      // get RIT (ON/OFF) status
+      Serial.print(F("RT"));
+      Serial.print(rit);
+      Serial.print(';');
     }
   }
 
+  // clear the RIT offset
+  else if (cmpstr(cmd, PSTR("RC"))) {
+    getsemi();
+    set_rit(0);
+  }
+
+  // move the RIT offset up or down
+  else if (cmpstr(cmd, PSTR("RU")) || cmpstr(cmd, PSTR("RD"))) {
+    int32_t d = RIT_STEP;
+    ch = getc();
+    if (numeric(ch)) {
+      d = (ch - '0') * 10000L + getnum(4);
+      getsemi();
+    }
+    if (cmd[1] == 'D') d = -d;
+    set_rit(rit_ofs + d);
+  }
+
   // get or set the XIT (ON/OFF) status
-  else if (cmpstr(cmd, "XT")) {
+  // there is no transmitter: XIT is only kept and reported
+  else if (cmpstr(cmd, PSTR("XT"))) {
     ch = getc();
     if (numeric(ch)) {
       // set XIT (ON/OFF) status
-      // does nothing .. always OFF
       getsemi();
+      xit = (ch == '1');
     } else {
       // get XIT (ON/OFF) status
-      Serial.print("XT0;");
+      Serial.print(F("XT"));
+      Serial.print(xit);
+      Serial.print(';');
+    }
+  }
+
+  // get or set the scan status
+  // 0=OFF 1=current band 2=band list 3=CAT SS range
+  else if (cmpstr(cmd, PSTR("SC"))) {
+    ch = getc();
+    if (numeric(ch)) {
+      // set scan status
+      getsemi();
+      if (ch <= '3') scanmode = ch - '0';
+    } else {
+      // get scan status
+      Serial.print(F("SC"));
+      Serial.print(scanmode);
+      Serial.print(';');
     }
   }
 
   // CAT transmit -- always rx
-  else if (cmpstr(cmd, "TX")) {
+  else if (cmpstr(cmd, PSTR("TX"))) {
     getsemi(); // get semicolon
   }
 
   // CAT receive -- always rx
-  else if (cmpstr(cmd, "RX")) {
+  else if (cmpstr(cmd, PSTR("RX"))) {
     getsemi(); // get semicolon
   }
 
@@ -769,34 +1054,73 @@ void CAT_cmd() {
   // ===========================
 
   // print help
-  if (cmpstr(cmd, "HE")) {
+  if (cmpstr(cmd, PSTR("HE"))) {
     show_help();
   }
 
   // print help
-  else if (cmpstr(cmd, "HH")) {
+  else if (cmpstr(cmd, PSTR("HH"))) {
     show_help();
   }
 
   // toggle debug on/off
-  else if (cmpstr(cmd, "DD")) {
+  else if (cmpstr(cmd, PSTR("DD"))) {
     show_debug();
   }
 
   // print info
-  else if (cmpstr(cmd, "II")) {
+  else if (cmpstr(cmd, PSTR("II"))) {
     show_info();
   }
 
+  // get or set the scan range and dwell, then scan it
+  // P1 start (11) P2 step Hz (6) P3 channels (2) P4 dwell ms (3)
+  else if (cmpstr(cmd, PSTR("SS"))) {
+    ch = getc();
+    if (numeric(ch)) {
+      catstr(param, ch);
+      for (uint8_t i=0; i<10; i++) {
+        catstr(param, getc());
+      }
+      scan_f0 = fs2int(param);
+      scan_step = getnum(6);
+      scan_n = min(getnum(2), SCAN_N);
+      scan_dwell = getnum(3);
+      getsemi();
+      scanmode = SCAN_RANGE;
+      scan_cur = OFF;   // restart
+    } else {
+      Serial.print(F("SS"));
+      CAT_num(scan_f0, 11);
+      CAT_num(scan_step, 6);
+      CAT_num(scan_n, 2);
+      CAT_num(scan_dwell, 3);
+      Serial.print(';');
+    }
+  }
+
+  // print the scan levels
+  else if (cmpstr(cmd, PSTR("SD"))) {
+    show_scan();
+  }
+
   // factory reset
-  else if (cmpstr(cmd, "FR")) {
+  else if (cmpstr(cmd, PSTR("FR"))) {
     do_reset(FACTORY);
   }
 
   // soft reset
-  else if (cmpstr(cmd, "SR")) {
+  else if (cmpstr(cmd, PSTR("SR"))) {
     do_reset(SOFT);
   }
+
+#if ISR_PROF
+  // print and clear the ISR profile
+  else if (cmpstr(cmd, PSTR("PR"))) {
+    getsemi();
+    prof_dump();
+  }
+#endif
 }
 
 // reset display timeout
@@ -820,6 +1144,154 @@ void check_timeout() {
   }
 }
 
+// S-meter reading on the TS-2000 scale
+// 0..15 = S0..S9 (3.6dB steps), 16..30 = S9+4..S9+60 (4dB steps)
+uint8_t smeter_units() {
+  int16_t db = recv.smeter() - SM_S9;
+  int16_t v;
+  if (db <= 0) v = 15 + (db * 5) / 18;
+  else v = 15 + db / 4;
+  return min(max(v, 0), 30);
+}
+
+// update the S-meter bar
+void check_smeter() {
+  if (scope || scan_cur || (menumode != NOT_IN_MENU) || (display == OFF)) return;
+  if ((msTimer - smtimer) < SMETER_MS) return;
+  smtimer = msTimer;
+  uint8_t len = (smeter_units() * 8) / 5;
+  if (len == smbar) return;  // no change
+  smbar = len;
+  oled.drawBar(SM_COL, SM_WIDTH, len);
+}
+
+// bandscope task
+// runs one short step per call (capture, window, one FFT stage, levels
+// or one display page) so CAT and the encoder are never held off; the
+// frame rate follows the CPU time the sample clock ISR leaves free
+#define SCOPE_FLOOR  64   // bottom pixel level, 48dB below ADC full scale
+
+// height (0..32) of column c, kept in its bin after the level step
+#define SCOPE_H(c)  (((uint8_t *)scope_buf)[4 * fft_col2bin(c)])
+
+void check_scope() {
+  if (!scope || scan_cur || (menumode != NOT_IN_MENU) || (display == OFF)) {
+    if (scope_step) recv.scope_stop();            // the scanner may take the buffer
+    scope_step = 0;
+    return;
+  }
+  uint8_t s = scope_step;
+  if (s == 0) {
+    scan.clear();                                 // the capture overwrites the scan levels
+    recv.scope_arm(scope_buf);                    // start a capture
+  } else if (s == 1) {
+    if (!recv.scope_ready()) return;              // wait for the capture
+    fft_window(scope_buf);
+  } else if (s < 2 + FFT_LOG2) {
+    fft_stage(scope_buf, s - 2);                  // one FFT stage
+  } else if (s == 2 + FFT_LOG2) {
+    for (uint8_t c = 0; c < FFT_N; c++) {         // column heights
+      int16_t h = (fft_level(scope_buf, fft_col2bin(c)) - SCOPE_FLOOR) >> 2;
+      SCOPE_H(c) = min(max(h, 0), 32);
+    }
+  } else {
+    draw_scope(s - 3 - FFT_LOG2);                 // one display page
+    if (s == 6 + FFT_LOG2) s = 0xff;              // last page
+  }
+  scope_step = s + 1;
+}
+
+// draw one page (0..3) of the bandscope, or of the scan bar graph,
+// on the top half of the display
+// 48dB range, 1.5dB per pixel, two pixels per column
+void draw_scope(uint8_t page) {
+  uint8_t buf[16];
+  oled.setPage(0, page);
+  for (uint8_t x = 0; x < OLED_MAXCOL; x += 16) {
+    for (uint8_t i = 0; i < 16; i += 2) {
+      uint8_t c = (x + i) >> 1;
+      int8_t f = 32 - (scan_cur ? scan_height(c) : SCOPE_H(c)) - (page << 3);  // first lit row
+      if (f >= 8) buf[i] = 0x00;
+      else if (f <= 0) buf[i] = 0xff;
+      else buf[i] = 0xff << f;
+      buf[i+1] = buf[i];
+    }
+    oled.senddata(buf, 16);
+  }
+}
+
+// band scanner task
+// scan.step() retunes and reads one channel at a time between the other
+// tasks.  After each sweep the levels are drawn as a bar graph on the
+// top half of the display, one page per call while the next sweep runs,
+// and line 1 shows the strongest channel.  Entering the menu or turning
+// the encoder stops the scan.
+#define SCAN_FLOOR  (SM_S9 - 36)   // bottom of the bar graph (S3)
+
+// bar graph height (0..32) of display column c
+// 48dB range, 1.5dB per pixel, as the bandscope
+uint8_t scan_height(uint8_t c) {
+  int16_t h = ((scan.lvl[(c * scan.n) / FFT_N] - SCAN_FLOOR) * 2) / 3;
+  return min(max(h, 0), 32);
+}
+
+void check_scan() {
+  uint8_t m = (menumode == NOT_IN_MENU) ? scanmode : OFF;
+  if (m != scan_cur) {
+    scan_cur = m;
+    if (m) {
+      scan_start();
+    } else {
+      scan.stop();
+      if (menumode == NOT_IN_MENU) update_display();   // back to the VFO
+    }
+  }
+  if (!scan_cur) return;
+  if (scan.step(msTimer)) {
+    scan_page = 0;
+  } else if ((scan_page < 5) && (display == ON)) {
+    if (scan_page < 4) draw_scope(scan_page);
+    else oled.printline(1, freq2str(scan.freq(scan.peak())));
+    scan_page++;
+  }
+}
+
+// start the scan of scan_cur
+void scan_start() {
+  if (scan_cur == SCAN_LIST) {
+    scan.start_list(bandfreq, BAND_10M + 1, scan_dwell);
+  } else if ((scan_cur == SCAN_RANGE) && scan_step) {
+    scan.start(scan_f0, scan_step, scan_n, scan_dwell);
+  } else {
+    int32_t lo = pgm_read_dword(&bandedge[2*radioband]);
+    int32_t hi = pgm_read_dword(&bandedge[2*radioband+1]);
+    scan.start(lo, (hi - lo) / SCAN_N, SCAN_N, scan_dwell);
+  }
+  scan_page = 0xff;
+  oled.clrScreen();
+  oled.showCursor(OFF);
+  oled.printline(1, F("Scanning"));
+}
+
+// print the scan levels to serial port
+void show_scan() {
+  uint16_t r = scan.rate();
+  Serial.print(F("scan "));
+  Serial.print(scan.n);
+  Serial.print(F(" ch, "));
+  Serial.print(scan.sweep_ms);
+  Serial.print(F(" ms/sweep, "));
+  Serial.print(r / 10);
+  Serial.print('.');
+  Serial.print(r % 10);
+  Serial.print(F(" ch/s\r\n"));
+  for (uint8_t c = 0; c < scan.nlvl; c++) {
+    Serial.print(scan.freq(c));
+    Serial.print(' ');
+    Serial.println((int16_t)scan.lvl[c]);
+  }
+}
+
 // check the UI pushbuttons
 void check_UI() {
   uint8_t event = NBP;
@@ -885,9 +1357,10 @@ void check_UI() {
         }
       } else {
         // SW2 click updates the step size
+        // 1M .. 1 Hz, then RIT
         stepsize_cursor();
-        stepsize--;
-        if (stepsize < STEP_1)  stepsize = STEP_1M;
+        if (stepsize == STEP_RIT) stepsize = STEP_1M;
+        else stepsize--;
         stepsize_cursor();
         wait_ms(DEBOUNCE);
       }
@@ -924,6 +1397,7 @@ void check_UI() {
     // no buttons are pressed
     // use the encoder to update the VFO
     if (enc_val && !menumode) {
+      scanmode = OFF;
       update_freq(1);
     }
     check_timeout();   // check for display timeout
@@ -955,6 +1429,13 @@ const int32_t bandfreq[] = {
   18100000, 21074000, 24915000, 28074000
 };
 
+// band edges for the si5351 band table (Hz)
+const int32_t bandedge[] PROGMEM = {
+  3500000,  4000000,  5250000,  5450000,  7000000,  7300000,
+  10100000, 10150000, 14000000, 14350000, 18068000, 18168000,
+  21000000, 21450000, 24890000, 24990000, 28000000, 29700000
+};
+
 // exit menu and update display
 void exit_menu() {
   menumode = NOT_IN_MENU;
@@ -972,9 +1453,9 @@ void lock_encoder() {
   enc_locked = !enc_locked;
   oled.clrScreen();
   oled.showCursor(OFF);
-  oled.printline(0, "Encoder");
-  if (enc_locked) oled.printline(1, "Locked");
-  else oled.printline(1, "Unlocked");
+  oled.printline(0, F("Encoder"));
+  if (enc_locked) oled.printline(1, F("Locked"));
+  else oled.printline(1, F("Unlocked"));
   wait_ms(ONE_SECOND);
 }
 
@@ -990,12 +1471,17 @@ void menuAction(uint8_t id) {
     case VOLUME:     paramAction(id, &volume,    NULL,         5, 12); break;
     case RADIOMODE:  paramAction(id, &radiomode, mode_label,   0,  2); break;
     case RADIOBAND:  paramAction(id, &radioband, band_label,   0,  8); break;
-    case FILTERBW:   paramAction(id, &filterbw,  filtbw_label, 0,  3); break;
+    case FILTERBW:   paramAction(id, &filterbw,  filtbw_label, 0,  6); break;
     case RX_ATTN:    paramAction(id, &rx_attn,   rxatt_label,  0,  1); break;
     case DG_ATTN:    paramAction(id, &dg_attn,   dgatt_label,  0,  6); break;
-    case AGC:        paramAction(id, &agc,       onoff_label,  0,  1); break;
+    case AGC:        paramAction(id, &agc,       agc_label,    0,  3); break;
     case CWTONE:     paramAction(id, &cwtone,    cwtone_label, 0,  1); break;
     case DXBLANK:    paramAction(id, &dxblank,   dxbk_label,   0,  2); break;
+    case SCOPE:      paramAction(id, &scope,     onoff_label,  0,  1); break;
+    case SCANNER:    paramAction(id, &scanmode,  scan_label,   0,  3); break;
+    case RIT:        paramAction(id, &rit,       onoff_label,  0,  1); break;
+    case IQBAL:      paramAction(id, &iqbal,     iqbal_label,  0,  2); break;
+    case DACMODE:    paramAction(id, &dacmode,   dac_label,    0,  5); break;
     case CALIBRATE:  calibrate(); break;
     case SAVE2EE:    save2ee(); break;
     case RESET:      menu_reset(); break;
@@ -1006,7 +1492,7 @@ void menuAction(uint8_t id) {
 }
 
 // parameters actions
-void paramAction(uint8_t id, uint8_t* ptr, const char* sap[], uint8_t min, uint8_t max) {
+void paramAction(uint8_t id, uint8_t* ptr, const char* sap, uint8_t min, uint8_t max) {
   uint8_t value = *ptr;
   int16_t newvalue;
   switch (menumode) {
@@ -1044,7 +1530,24 @@ void paramAction(uint8_t id, uint8_t* ptr, const char* sap[], uint8_t min, uint8
           break;
       }
       enc_val = 0;
-      *ptr = value;
+      if (value != *ptr) {
+        *ptr = value;
+        switch (id) {
+          case RADIOMODE:
+          case FILTERBW:
+          case AGC:
+          case IQBAL:
+          case DACMODE:
+            recv.configure();  // rebind the DSP kernels
+            break;
+          case VOLUME:
+          case DG_ATTN:
+            recv.set_gain();
+            break;
+          default:
+            break;
+        }
+      }
       show_value(id, value, sap);
       break;
     default:
@@ -1056,29 +1559,27 @@ char menulabel[20];
 
 // get label string
 void get_label(uint8_t id, const char* str) {
-  uint8_t  done = 0;
-  uint16_t i = 0;
-  uint8_t  j = 0;
-  uint8_t  k = 0;
-  char ch = ' ';
-  while (!done) {
-    ch = str[i++];
-    if (ch != '|') {
-      menulabel[j++] = ch;
-    } else {
-      if ((menumode == SELECT_VALUE) && (menu != SWVER)) {
-        menulabel[j++] = ' ';
-        menulabel[j++] = '>';
-      }
-      menulabel[j] = 0;
-      if (k == id) done = 1;
-      else j = 0;
-      k++;
-    }
-    if (!ch) done = 1;
+  uint8_t j = len(get_item(str, id));
+  if ((menumode == SELECT_VALUE) && (menu != SWVER)) {
+    menulabel[j++] = ' ';
+    menulabel[j++] = '>';
+    menulabel[j] = 0;
   }
 }
 
+// copy item k of a '|' terminated PROGMEM list to menulabel
+char* get_item(const char* str, uint8_t k) {
+  uint8_t j = 0;
+  char ch;
+  while (k && (ch = pgm_read_byte(str))) {
+    str++;
+    if (ch == '|') k--;
+  }
+  while (((ch = pgm_read_byte(str++)) != '|') && ch) menulabel[j++] = ch;
+  menulabel[j] = 0;
+  return menulabel;
+}
+
 // print a menu label
 void show_label(uint8_t id) {
   get_label(id, mlabel);
@@ -1087,48 +1588,75 @@ void show_label(uint8_t id) {
 }
 
 // print a menu value field
-void show_value (uint8_t id, uint8_t val, const char* sap[]) {
+void show_value (uint8_t id, uint8_t val, const char* sap) {
   oled.clrLine(1);
   switch (id) {
     case SWVER:
-      oled.printline(1, VERSION);
+      oled.printline(1, F(VERSION));
       break;
     default:
       if (sap == NULL) {
         oled.printline(1, int2str(val));
       } else {
-        oled.printline(1, (char *)sap[val]);
+        oled.printline(1, get_item(sap, val));
       }
   }
 }
 
 // update the displayed frequency
 void update_freq(uint8_t x) {
+  if (x && (stepsize == STEP_RIT)) {
+    // the encoder tunes the RIT offset
+    rit = ON;
+    set_rit(rit_ofs + enc_val * RIT_STEP);
+    enc_val = 0;
+    stepsize_cursor();
+    return;
+  }
   int32_t stepval = stepsizes[stepsize];
   if (x) vfofreq += enc_val * stepval;
-  if (radiomode == CW) si5351.freq(vfofreq - ct[cwtone], 0, iq_phase);
-  else si5351.freq(vfofreq, 0, iq_phase);
+  tune_vfo(vfofreq);
   enc_val = 0;
   oled.printline(1, freq2str(vfofreq));
   catfreq = vfofreq;
   stepsize_cursor();
 }
 
+// tune the VFO to the dial f plus the RIT offset, CW at the tone offset
+// within +/-5 kHz of the last full retune only the MSNA fraction is sent;
+// on the same dial (RIT, mode, redraw) only the MSNA moves, no PLL reset
+void tune_vfo(int32_t f) {
+  int32_t lo = f;
+  if (rit) lo += rit_ofs;
+  if (radiomode == CW) lo -= ct[cwtone];
+  if (f == vfo_dial) si5351.freq_pll(lo);
+  else si5351.freq_fast(lo, 0, iq_phase);
+  vfo_dial = f;
+}
+
+// set the RIT offset (Hz, clamped) and retune
+void set_rit(int32_t ofs) {
+  rit_ofs = min(max(ofs, -RIT_MAX), RIT_MAX);
+  tune_vfo(vfofreq);
+  if (!menumode) show_mode();
+}
+
 // reset (CAT command)
 void do_reset(uint8_t soft) {
   reset_xtimer();
   oled.clrScreen();
   if (soft) {
     // soft reset
-    oled.putstr("SOFT RESET");
-    Serial.print("Soft Reset\r\n");
+    oled.putstr(F("SOFT RESET"));
+    Serial.print(F("Soft Reset\r\n"));
     init_soft();
   } else {
     // factory reset
-    oled.putstr("FACTORY RESET");
-    Serial.print("Factory Reset\r\n");
+    oled.putstr(F("FACTORY RESET"));
+    Serial.print(F("Factory Reset\r\n"));
     init_factory();
   }
+  recv.configure();
 }
 
 // calibrate
@@ -1183,8 +1711,8 @@ void calibrate() {
       // wait for SW2 released
       while (SW2_PRESSED) wait_ms(DEBOUNCE);
       oled.clrScreen();
-      oled.printline(0, "Save Calibration?");
-      oled.printline(1, "YES");
+      oled.printline(0, F("Save Calibration?"));
+      oled.printline(1, F("YES"));
 
       // stay in yes/no loop until SW2 is pressed
       while (!SW2_PRESSED) {
@@ -1192,17 +1720,17 @@ void calibrate() {
           save = !save;
           enc_val = 0;
           oled.clrLine(1);
-          if (save) oled.printline(1, "YES");
-          else oled.printline(1, "NO");
+          if (save) oled.printline(1, F("YES"));
+          else oled.printline(1, F("NO"));
         }
       }
       oled.clrScreen();
-      oled.printline(0, "Calibration");
+      oled.printline(0, F("Calibration"));
       if (save) {
         eeprom.put32(CAL_ADDR, si5351.fxadj);
-        oled.printline(1, "saved to eeprom");
+        oled.printline(1, F("saved to eeprom"));
       } else {
-        oled.printline(1, "not saved");
+        oled.printline(1, F("not saved"));
       }
       wait_ms(TWO_SECONDS);
       exit_menu();
@@ -1226,7 +1754,7 @@ void save2ee() {
       while (!SW2_PRESSED) {
         // save to eeprom if SW1 pressed
         if (SW1_PRESSED) {
-          oled.printline(1, "saving eeprom");
+          oled.printline(1, F("saving eeprom"));
           save_eeprom();
           wait_ms(ONE_SECOND);
           // wait for SW1 released
@@ -1298,6 +1826,12 @@ void save_eeprom() {
   eeprom.put(AGC_ADDR,  agc);
   eeprom.put(TONE_ADDR, cwtone);
   eeprom.put(DXBK_ADDR, dxblank);
+  eeprom.put(SCOP_ADDR, scope);
+  eeprom.put(IQBL_ADDR, iqbal);
+  int16_t p, g;
+  recv.iq_get(&p, &g);
+  eeprom.put32(IQ_ADDR, ((uint32_t)(uint16_t)p << 16) | (uint16_t)g);
+  eeprom.put(DACM_ADDR, dacmode);
 }
 
 // read config data from the eeprom
@@ -1313,6 +1847,21 @@ void init_soft() {
   agc       = eeprom.get(AGC_ADDR);
   cwtone    = eeprom.get(TONE_ADDR);
   dxblank   = eeprom.get(DXBK_ADDR);
+  scope     = eeprom.get(SCOP_ADDR);
+  if (scope > ON) scope = OFF;          // not saved yet (0xff)
+  iqbal     = eeprom.get(IQBL_ADDR);
+  uint32_t iq = eeprom.get32(IQ_ADDR);
+  int16_t p = iq >> 16;
+  int16_t g = iq & 0xffff;
+  if ((iqbal > IQ_HOLD) || (p < -IQ_LIMIT) || (p > IQ_LIMIT) || (g < -IQ_LIMIT) || (g > IQ_LIMIT)) {
+    // not saved yet: no correction
+    iqbal = OFF;
+    p = 0;
+    g = 0;
+  }
+  recv.iq_set(p, g);
+  dacmode   = eeprom.get(DACM_ADDR);
+  if (dacmode > DAC_CIC3NS2) dacmode = DAC_CIC2;   // not saved yet (0xff)
 
 /*
   Serial.println(vfofreq);
@@ -1348,6 +1897,10 @@ void init_factory() {
   rx_attn   = 0;         // analog  attenuation
   dg_attn   = 4;         // digital attenuation
   agc       = OFF;       // auto gain control
+  scope     = OFF;       // bandscope
+  iqbal     = OFF;       // I/Q balance
+  recv.iq_set(0, 0);
+  dacmode   = DAC_CIC2;  // DAC output mode
   save_eeprom();
 }
 
@@ -1404,6 +1957,7 @@ void init_vfo() {
     si5351.fxtal = F_XTAL - tmp;
   }
   si5351.iqmsa = 0;   // PLL reset
+  si5351.plan(bandedge, 9);
 }
 
 #define BAUDRATE 115200
@@ -1432,6 +1986,7 @@ void init_encoder() {
 // init receiver
 void init_recv() {
   recv.begin();
+  scan.begin(&recv, tune_vfo, (int8_t *)scope_buf);
 }
 
 // program setup
@@ -1443,6 +1998,7 @@ void setup() {
   init_i2c();
   init_oled();
   init_vfo();
+  PROF_INIT();
   init_recv();
   if (ANY_PRESSED) {
     do_reset(FACTORY);
@@ -1459,5 +2015,9 @@ void loop() {
   check_CAT();      // check CAT interface
   check_UI();       // check UI pushbutton
   check_menu();     // check for menu ops
+  check_smeter();   // update the S-meter
+  check_scope();    // run the bandscope
+  check_scan();     // run the band scanner
+  if (iqbal == IQ_AUTO) recv.iq_adapt();  // track the I/Q balance
 }
 
@@ -39,6 +39,11 @@ void OLED::senddata(uint8_t data) {
   i2c1.write(OLED_ADDR, OLED_DATA, data);
 }
 
+// send a block of data
+void OLED::senddata(uint8_t *data, uint8_t nbytes) {
+  i2c1.write(OLED_ADDR, OLED_DATA, data, nbytes);
+}
+
 // send zeros
 void OLED::sendzeros(uint8_t nbytes) {
   i2c1.writezeros(OLED_ADDR, OLED_DATA, nbytes);
@@ -160,12 +165,37 @@ void OLED::putstr(char *str) {
   clr2eol();
 }
 
+// print a string from flash
+void OLED::putstr(const __FlashStringHelper *str) {
+  const char *p = (const char *)str;
+  char ch;
+  while ((ch = pgm_read_byte(p++))) putch(ch);
+  clr2eol();
+}
+
 // print a line
 void OLED::printline(uint8_t row, char *str) {
   setCursor(0,row);
   putstr(str);
 }
 
+// print a line from flash
+void OLED::printline(uint8_t row, const __FlashStringHelper *str) {
+  setCursor(0,row);
+  putstr(str);
+}
+
+// draw a horizontal bar on pages 1 and 2
+// starting at column x, len of width pixels set
+void OLED::drawBar(uint8_t x, uint8_t width, uint8_t len) {
+  if (len > width) len = width;
+  for (uint8_t p=1; p<3; p++) {
+    setPage(x, p);
+    if (len) sendones(len);
+    if (len < width) sendzeros(width - len);
+  }
+}
+
 // print an 8-bit integer value
 void OLED::print8(uint8_t val) {
   char tmp[4] = "  0";
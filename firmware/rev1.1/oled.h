@@ -26,6 +26,7 @@ public:
   void end();
   void wait(uint16_t);
   void senddata(uint8_t);
+  void senddata(uint8_t *, uint8_t);
   void sendzeros(uint8_t);
   void sendones(uint8_t);
   void noDisplay();
@@ -39,11 +40,14 @@ public:
   void clrScreen();
   void putch(uint8_t);
   void putstr(char *);
+  void putstr(const __FlashStringHelper *);
   void printline(uint8_t, char *);
+  void printline(uint8_t, const __FlashStringHelper *);
   void print8(uint8_t);
   void print16(uint16_t);
   void print32(uint32_t);
   void print_freq(uint64_t);
+  void drawBar(uint8_t, uint8_t, uint8_t);
 
   // variables
   uint8_t oledX;
@@ -0,0 +1,104 @@
+
+// ============================================================================
+//
+// prof.cpp   - ISR cycle and jitter profiling
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "prof.h"
+
+#if ISR_PROF
+
+volatile prof_t prof;
+
+static uint8_t t1_last;     // TCNT1 at the last sample clock ISR entry
+static uint8_t t1_valid;    // t1_last is from the previous tick
+
+// record one sample clock ISR
+// t1/t2 are TCNT1/TCNT2 at entry and exit, late is the pending compare
+// match flag at exit and ph the rxstate phase
+void prof_isr(uint8_t t1e, uint8_t t2e, uint8_t t1x, uint8_t t2x, uint8_t late, uint8_t ph) {
+  // TCNT2 gives the cycles to +/-63, TCNT1 the cycles mod 256
+  int16_t coarse = ((int16_t)t2x - t2e) * 64;
+  if (late) {
+    coarse += PROF_TICK;  // TCNT2 has wrapped
+    prof.overruns++;
+  }
+  uint8_t fine = t1x - t1e;
+  int16_t k = (coarse - fine + 128) >> 8;
+  uint16_t c = fine + ((k > 0) ? (k << 8) : 0);
+  if (c < prof.cmin[ph]) prof.cmin[ph] = c;
+  if (c > prof.cmax[ph]) prof.cmax[ph] = c;
+  uint8_t b = (c < PROF_TICK/2) ? 0 : (c < PROF_TICK*3/4) ? 1 : (c < PROF_TICK) ? 2 : 3;
+  if (prof.hist[ph][b] != 0xffff) prof.hist[ph][b]++;
+
+  // entry to entry interval less one tick
+  if (t1_valid) {
+    int8_t j = (uint8_t)(t1e - t1_last - (uint8_t)PROF_TICK);
+    if (j < prof.jmin) prof.jmin = j;
+    if (j > prof.jmax) prof.jmax = j;
+  }
+  t1_last = t1e;
+  t1_valid = !late;
+}
+
+// record a short ISR (less than 256 cycles)
+void prof_short(uint8_t t1e, volatile uint8_t *max) {
+  uint8_t c = TCNT1L - t1e;
+  if (c > *max) *max = c;
+}
+
+// clear the counters
+void prof_clear() {
+  noInterrupts();
+  for (uint8_t p = 0; p < PROF_PHASES; p++) {
+    prof.cmin[p] = 0xffff;
+    prof.cmax[p] = 0;
+    for (uint8_t b = 0; b < 4; b++) prof.hist[p][b] = 0;
+  }
+  prof.overruns = 0;
+  prof.jmin = 127;
+  prof.jmax = -128;
+  prof.enc_max = 0;
+  prof.ms_max = 0;
+  t1_valid = 0;
+  interrupts();
+}
+
+// print a number right aligned in w columns
+static void prof_num(uint16_t v, uint8_t w) {
+  uint8_t n = 1;
+  for (uint16_t t = v; t >= 10; t /= 10) n++;
+  for (; n < w; n++) Serial.print(' ');
+  Serial.print(v);
+}
+
+// print and clear the counters (CAT PR)
+void prof_dump() {
+  Serial.print(F("PR tick="));
+  Serial.print(PROF_TICK);
+  Serial.print(F(" overruns="));
+  Serial.print(prof.overruns);
+  Serial.print(F(" jitter="));
+  Serial.print(prof.jmin);
+  Serial.print('/');
+  Serial.print(prof.jmax);
+  Serial.print(F(" enc="));
+  Serial.print(prof.enc_max);
+  Serial.print(F(" ms="));
+  Serial.print(prof.ms_max);
+  Serial.print(F("\r\n ph  min  max   <1/2   <3/4     <1    >=1\r\n"));
+  for (uint8_t p = 0; p < PROF_PHASES; p++) {
+    prof_num(p, 3);
+    prof_num((prof.cmin[p] == 0xffff) ? 0 : prof.cmin[p], 5);
+    prof_num(prof.cmax[p], 5);
+    for (uint8_t b = 0; b < 4; b++) prof_num(prof.hist[p][b], 7);
+    Serial.print(F("\r\n"));
+  }
+  Serial.print(';');
+  prof_clear();
+}
+
+#endif
@@ -0,0 +1,87 @@
+// ============================================================================
+//
+// prof.h   - ISR cycle and jitter profiling
+//
+// Built with ISR_PROF=1 the interrupt handlers are timestamped on entry
+// and exit.  TCNT1 (the PWM timer, one count per CPU cycle, period 256)
+// gives the cycles and TCNT2 (the sample clock, 64 cycles per count)
+// resolves the TCNT1 wrap.  Kept for the sample clock ISR:
+//
+//   per rxstate phase   min/max cycles and a histogram of the cycles
+//                       against the tick (<1/2, <3/4, <1, >=1 tick)
+//   overruns            compare match already pending at exit
+//   jitter              entry-to-entry interval less one tick, min/max
+//
+// and the longest encoder (PCINT0/2) and ms timer (TIMER0) ISR body.
+// The CAT PR command prints and clears the counters.  With ISR_PROF=0
+// the macros are empty and nothing is compiled.  The profiler adds
+// about 150 cycles to the sample clock ISR (make isr-bench
+// DEFS=-DISR_PROF=1, clang/LLVM AVR build).
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "globals.h"
+
+#ifndef PROF_H
+#define PROF_H
+
+#if ISR_PROF
+
+#define PROF_PHASES  (2*DSP_DECIM)          // rxstate phases
+#define PROF_TICK    (F_CPU / ADC_RATE)     // cycles per sample clock tick
+
+struct prof_t {
+  uint16_t cmin[PROF_PHASES];      // cycles, per phase
+  uint16_t cmax[PROF_PHASES];
+  uint16_t hist[PROF_PHASES][4];   // cycle histogram, per phase
+  uint16_t overruns;               // ticks late at exit
+  int8_t   jmin, jmax;             // entry jitter (cycles)
+  uint8_t  enc_max;                // longest encoder ISR (cycles)
+  uint8_t  ms_max;                 // longest ms timer ISR (cycles)
+};
+
+extern volatile prof_t prof;
+
+void prof_isr(uint8_t t1e, uint8_t t2e, uint8_t t1x, uint8_t t2x, uint8_t late, uint8_t ph);
+void prof_short(uint8_t t1e, volatile uint8_t *max);
+void prof_clear();
+void prof_dump();
+
+#define PROF_INIT()  prof_clear()
+
+// sample clock ISR exit
+// the compare match flag is read before and after TCNT2, so the two
+// agree even when the match falls between the reads
+static inline void prof_exit(uint8_t t1e, uint8_t t2e, uint8_t ph) {
+  uint8_t late = TIFR2 & (1 << OCF2A);
+  uint8_t t2x = TCNT2;
+  uint8_t t1x = TCNT1L;
+  if (!late && (TIFR2 & (1 << OCF2A))) {
+    late = 1;           // TCNT2 may have wrapped: read it again
+    t2x = TCNT2;
+    t1x = TCNT1L;
+  }
+  prof_isr(t1e, t2e, t1x, t2x, late, ph);
+}
+
+// sample clock ISR
+#define PROF_ENTER(ph)   uint8_t prof_t1 = TCNT1L, prof_t2 = TCNT2, prof_ph = (ph)
+#define PROF_EXIT()      prof_exit(prof_t1, prof_t2, prof_ph)
+
+// short ISRs: longest run in cycles
+#define PROF_SHORT_ENTER()   uint8_t prof_t1 = TCNT1L
+#define PROF_SHORT_EXIT(m)   prof_short(prof_t1, &prof.m)
+
+#else
+
+#define PROF_INIT()
+#define PROF_ENTER(ph)
+#define PROF_EXIT()
+#define PROF_SHORT_ENTER()
+#define PROF_SHORT_EXIT(m)
+
+#endif
+
+#endif
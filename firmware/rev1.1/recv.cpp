@@ -8,30 +8,31 @@
 #include <Arduino.h>
 #include <inttypes.h>
 #include "recv.h"
+#include "hal.h"
+#include "fir.h"
+#include "fft.h"
+#include "decim.h"
+#include "filters.h"
 
 #pragma GCC push_options
 #pragma GCC optimize ("Ofast")  // compiler-optimization for speed
 
-RECV::RECV() {
-}
-
-// Public Methods
-
-static int16_t ocomb, ozi1, ozi2;
-
 extern uint8_t radiomode;   // radio mode
 extern uint8_t volume;      // audio volume
 extern uint8_t filterbw;    // filter bandwidth
 extern uint8_t dg_attn;     // digital attenuation
 extern uint8_t agc;         // auto gain control
+extern uint8_t iqbal;       // I/Q balance mode
+extern uint8_t dacmode;     // DAC interpolator / noise shaper
 extern uint8_t rxstate;     // rx state
 
 void RECV::begin() {
   init_adc();
   init_dac();
   set_dac_sample_rate(78125);
-  set_adc_sample_rate(62500);  // start timer2 ADC sample clock
+  set_adc_sample_rate(ADC_RATE);  // start timer2 ADC sample clock
   set_dac_audio_enable(true);  // speaker output enable
+  configure();
 }
 
 void RECV::end() {
@@ -39,243 +40,749 @@ void RECV::end() {
 
 // Hilbert transform I
 int16_t RECV::hilb_i(int16_t ac) {
-  static int16_t v[7];  // delay-line to match Hilbert transform on Q branch
-  for (int8_t i = 0; i != 6; i++) v[i] = v[i+1]; v[6] = ac;
-  return v[0];
+  uint8_t n = hi_n = (hi_n + 1) & 7;
+  hi_v[n] = ac;
+  return hi_v[(n + 2) & 7];  // 6 samples ago
 }
 
 // Hilbert transform Q
 int16_t RECV::hilb_q(int16_t ac) {
-  static int16_t v[14];  // delay-line
-  for (int8_t i = 0; i != 13; i++) v[i] = v[i+1]; v[13] = ac;
-  return ((v[0] - v[13]) + (v[2] - v[12]) * 4) / 64 + ((v[4] - v[10]) + (v[6] - v[8])) / 8 + ((v[4] - v[10]) * 5 - (v[6] - v[8]) ) / 128 + (v[6] - v[8]) / 2;
+  uint8_t n = hq_n = (hq_n - 1) & 15;
+  hq_d[n] = hq_d[n+16] = ac;
+  int16_t *v = &hq_d[n];
+  // 16-bit sums, so a host build wraps like the AVR int
+  int16_t a = (v[13] - v[0]) + (v[11] - v[1]) * 4;
+  int16_t b = (v[9] - v[3]) + (v[7] - v[5]);
+  int16_t c = (v[9] - v[3]) * 5 - (v[7] - v[5]);
+  int16_t d = v[7] - v[5];
+  return a / 64 + b / 8 + c / 128 + d / 2;
 }
 
 // AGC
-int16_t RECV::agc_fast(int16_t in) {
-  static int16_t gain = 1024;
-  int16_t agcout = (gain >= 1024) ? (gain >> 10) * in : in;
-  int16_t accum = (1 - abs(agcout >> 10));
-  if ((INT16_MAX - gain) > accum) gain = gain + accum;
-  if (gain < 1) gain = 1;
-  return agcout;
+// peak detector with attack, hang and decay working on the log2 of the
+// signal level; the gain is computed in the log domain and applied with
+// one multiply.  Levels and gains are in 1/16 octave (0.38 dB) steps.
+// In LOOK mode the detector runs on the I branch ahead of the hilb_i
+// delay, so the gain is settled before the signal reaches it.
+// Cost in the process() phase against agc=OFF, make isr-bench with a
+// clang/LLVM AVR build: FAST and SLOW 481-526 cycles, LOOK 540-547.
+
+#define AGC_TARGET  208   // output peak 8192 (13 octaves)
+#define AGC_GMIN    -32   // gain limits: -2 octaves (-12dB)
+#define AGC_GMAX     96   //              +6 octaves (+36dB)
+#define AGC_LA_OFS   30   // filter output over I branch level, dg_attn=0
+
+// hang and decay scale with the audio rate, attack is in samples
+#define AGC_MS(ms)  ((uint16_t)((uint32_t)AUDIO_RATE * (ms) / 1000))
+#define AGC_DK(d)   ((d) * 7812 / AUDIO_RATE)
+
+// indexed by agc mode, times at the 7812.5 Hz audio rate
+static const agc_par_t agc_par[] = {
+  { 0, 0,         0           },  // OFF
+  { 2, AGC_DK(4), AGC_MS(100) },  // FAST: 0.5ms attack, 100ms hang, 46dB/s decay
+  { 4, AGC_DK(1), AGC_MS(500) },  // SLOW:   2ms attack, 500ms hang, 11dB/s decay
+  { 1, AGC_DK(4), AGC_MS(100) }   // LOOK: FAST with look-ahead detection
+};
+
+// 16*log2(1 + (k+0.5)/16)
+static const uint8_t log_lut[16] PROGMEM = {
+  1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 13, 14, 15, 16
+};
+
+// 16384*2^(k/16)
+static const int16_t exp_lut[16] PROGMEM = {
+  16384, 17109, 17867, 18658, 19484, 20347, 21247, 22188,
+  23170, 24196, 25268, 26386, 27554, 28774, 30048, 31379
+};
+
+// level in 1/16 octave steps: 16*log2(a)
+// the normalize loop runs at most 7 times
+uint8_t log2q4(uint16_t a) {
+  if (!a) return 0;
+  uint8_t e = 15;
+  if (!(a & 0xff00)) {
+    a <<= 8;
+    e = 7;
+  }
+  while (!(a & 0x8000)) {
+    a <<= 1;
+    e--;
+  }
+  return (e << 4) + pgm_read_byte(&log_lut[(a >> 11) & 15]);
+}
+
+// AGC envelope detector, lvl is 16*log2 of the signal level
+void RECV::agc_detect(uint8_t lvl) {
+  uint16_t l = (uint16_t)lvl << 8;
+  if (l > env) {
+    env += (l - env) >> agcp.attack;  // attack
+    hang = agcp.hang;
+  } else if (hang) {
+    hang--;                           // hold
+  } else if (env > agcp.decay) {
+    env -= agcp.decay;                // decay
+  }
+}
+
+// look-ahead AGC detector on the I branch
+void RECV::agc_lookahead(int16_t in) {
+  uint16_t lvl = log2q4((in < 0) ? -in : in) + la_ofs;
+  agc_detect(min(lvl, 255));
+}
+
+// apply the AGC gain
+int16_t RECV::agc_gain(int16_t in) {
+  int16_t g = AGC_TARGET - (int16_t)(env >> 8);
+  g = min(max(g, AGC_GMIN), AGC_GMAX);
+  int32_t out = ((int32_t)in * (int16_t)pgm_read_word(&exp_lut[g & 15])) >> (14 - (g >> 4));
+  return min(max(out, INT16_MIN), INT16_MAX);
+}
+
+int16_t RECV::apply_agc(int16_t in) {
+  agc_detect(log2q4((in < 0) ? -in : in));
+  return agc_gain(in);
+}
+
+// S-meter
+// the sample kernel adds up the squares of the bandwidth filter output;
+// every SM_N samples the sum is published with a sequence count so the
+// main loop can take a consistent copy without blocking interrupts.
+// It costs 83 cycles per sample with the scan level idle, about 28
+// more on a publishing sample (make isr-bench, clang/LLVM AVR build).
+
+#define SM_N      256   // samples per S-meter block (33ms)
+#define SM_FS     336   // full scale sine mean square: 16*log2(2047^2/2)
+#define SM_CAL    7     // filter to ADC full scale at dg_attn=0 (dB)
+
+inline void RECV::smeter_acc(int16_t ac) {
+  int16_t a = ac >> 4;
+  mac16(sm_acc, a, a);
+  if (!++sm_n) {
+    sm_snap = sm_acc;
+    sm_seq++;
+    sm_acc = 0;
+  }
+  if (lv_n) {
+    if (lv_skip) lv_skip--;
+    else {
+      mac16(lv_acc, a, a);
+      lv_n--;
+    }
+  }
+}
+
+// 16*log2(a) of a 32-bit value
+static uint16_t log2q4_32(uint32_t a) {
+  if (!a) return 0;
+  uint8_t e = 31;
+  while (!(a & 0x80000000UL)) {
+    a <<= 1;
+    e--;
+  }
+  return (e << 4) + pgm_read_byte(&log_lut[(a >> 27) & 15]);
+}
+
+// 16*log2 of a mean square to dB relative to a full scale ADC sine
+static int8_t sm_db(int16_t lq) {
+  int16_t db = ((int32_t)(lq - SM_FS) * 193) >> 10;  // 10*log10(2)/16
+  return db + SM_CAL - 6 * dg_attn;
 }
 
+// S-meter level in dB relative to a full scale ADC sine (main loop)
+int8_t RECV::smeter() {
+  int32_t s;
+  uint8_t q;
+  do {
+    q = sm_seq;
+    s = sm_snap;
+  } while (q != sm_seq);
+  return sm_db(log2q4_32(s) - 16*8);
+}
+
+static_assert(RECV_SPAN >= 3 + 13 + 2*fircw300::M, "RECV_SPAN is shorter than the delay lines");
+
+// level reading: drop skip audio samples (the delay lines after a
+// retune), then add up 2^LEVEL_LOG2 of them on the S-meter scale
+void RECV::level_arm(uint8_t skip) {
+  noInterrupts();
+  lv_acc = 0;
+  lv_skip = skip;
+  lv_n = 1 << LEVEL_LOG2;
+  interrupts();
+}
+
+// level reading complete
+bool RECV::level_ready() {
+  return !lv_n;
+}
+
+// last level reading (dB, as smeter())
+int8_t RECV::level() {
+  return sm_db(log2q4_32(lv_acc) - 16*LEVEL_LOG2);
+}
+
+// DAC output
+// CIC interpolator by DSP_DECIM: the comb stages run at the audio rate
+// in dac_upsample(), the integrators at the DAC rate in load_dac_audio().
+// The 2nd order CIC truncated to 8 bits is the original output stage.
+// The 3rd order CIC rejects the images better.  The noise shaper feeds
+// the bits dropped by the 8-bit quantizer back into the next samples
+// (error feedback), which shapes the quantization noise by (1 - z^-1) or
+// (1 - z^-1)^2 and moves it from the audio band towards the DAC Nyquist
+// frequency.  ac3 carries DAC_FRAC bits below its 10-bit range for it.
+// Against CIC2 (make isr-bench, clang/LLVM AVR build) a DAC load in an
+// odd phase costs +5 cycles with NS1, +14 NS2, +3 CIC3, +15 CIC3 NS1 and
+// +23 CIC3 NS2; the comb in phase 0 +6 shaped, +20 3rd order.  The
+// other even phases do not change.
+
+// The comb output is held for DSP_DECIM integrator steps, so the gain is
+// DSP_DECIM^order.  The shifts scale ac3 by 1/2 into the PWM range.  The
+// shaped and 3rd order paths limit the input to the PWM range and keep
+// the integrators within +/-16384, leaving room for the error feedback;
+// at ratios over 4 the 3rd order CIC does not fit in 16 bits and those
+// modes use the 2nd order CIC.
+#define DAC_FRAC     2   // ac3 fraction bits
+#define DACN_SHIFT   7   // quantizer shift, shaped and 3rd order paths
+#if DSP_DECIM == 4
+#define DAC_PRE      0   // 2nd order, truncated: +/-512 * 16 >> 5
+#define DAC_SHIFT    5
+#define DAC2_PRE     0   // 2nd order: +/-1024 * 16 >> 7
+#define DAC3_PRE     2   // 3rd order: +/-256 * 64 >> 7
+#elif DSP_DECIM == 8
+#define DAC_PRE      0   // +/-512 * 64 >> 7
+#define DAC_SHIFT    7
+#define DAC2_PRE     2   // +/-256 * 64 >> 7
+#else
+#error "DSP_DECIM must be 4 or 8"
+#endif
+
+// comb section
+template<uint8_t ORDER, uint8_t SHAPE>
+void RECV::dac_comb_k(RECV *r, int16_t ac) {
+  if ((ORDER == 2) && !SHAPE) {
+    ac >>= DAC_FRAC + DAC_PRE;
+  } else {
+    ac = min(max(ac, -1024), 1024);
+#ifdef DAC3_PRE
+    ac >>= (ORDER == 2) ? DAC2_PRE : DAC3_PRE;
+#else
+    ac >>= DAC2_PRE;
+#endif
+  }
+  int16_t od1 = ac - r->ozd1;
+  int16_t od2 = od1 - r->ozd2;
+  r->ozd2 = od1;
+  r->ozd1 = ac;
+  if (ORDER == 2) {
+    r->ocomb = od2;
+  } else {
+    r->ocomb = od2 - r->ozd3;
+    r->ozd3 = od2;
+  }
+}
+
+// integrator section and quantizer
+template<uint8_t ORDER, uint8_t SHAPE>
+void RECV::dac_load_k(RECV *r) {
+  int16_t i1 = r->ozi1 = r->ocomb + r->ozi1;
+  int16_t i2 = r->ozi2 = i1 + r->ozi2;
+  if ((ORDER == 2) && !SHAPE) {
+    hal_dac_write(min(max((i2 >> DAC_SHIFT) + 128, 0), 255));
+    return;
+  }
+  int16_t v = i2;
+  if (ORDER == 3) v = r->ozi3 = i2 + r->ozi3;
+  if (SHAPE == 1) v += r->dac_r1;
+  if (SHAPE == 2) v += (r->dac_r1 << 1) - r->dac_r2;
+  if (SHAPE) {
+    r->dac_r2 = r->dac_r1;
+    r->dac_r1 = v & ((1 << DACN_SHIFT) - 1);
+  }
+  hal_dac_write(min(max((v >> DACN_SHIFT) + 128, 0), 255));
+}
+
+// indexed by dacmode
+#ifdef DAC3_PRE
+#define DAC_K3(s)  s<3, 0>, s<3, 1>, s<3, 2>
+#else
+#define DAC_K3(s)  s<2, 0>, s<2, 1>, s<2, 2>
+#endif
+const RECV::dac_comb_t RECV::dac_comb_bank[] = {
+  dac_comb_k<2, 0>, dac_comb_k<2, 1>, dac_comb_k<2, 2>, DAC_K3(dac_comb_k)
+};
+const RECV::dac_load_t RECV::dac_load_bank[] = {
+  dac_load_k<2, 0>, dac_load_k<2, 1>, dac_load_k<2, 2>, DAC_K3(dac_load_k)
+};
+
 void RECV::dac_upsample(int16_t ac) {
-  static int16_t ozd1, ozd2;  // output stage
-  int16_t od1 = ac - ozd1;    // comb section
-  ocomb = od1 - ozd2;
-  ozd2 = od1;
-  ozd1 = ac;
+  dac_comb(this, ac);
+}
+
+// I/Q balance
+// the kernel corrects I/Q gain and phase with two coefficients
+//   i' = i + g*i    q' = q + p*i'    (g and p in Q16)
+// and a side path adds up i'*i', q'*q' and i'*q' over blocks of IQ_N.
+// For a balanced receiver both I^2-Q^2 and I*Q average to zero;
+// iq_adapt() runs in the main loop and steers g and p to get there.
+
+#define IQ_N      64        // samples per estimate (8ms), 4096^2*64 fits
+#define IQ_MINPW  32768L    // minimum block power to adapt (-45dBFS)
+
+inline void RECV::iq_balance(int16_t &i, int16_t &q) {
+  int32_t t = 0;
+  mac16(t, i, iqk_g);
+  i += (int16_t)(t >> 16);
+  t = 0;
+  mac16(t, i, iqk_p);
+  q += (int16_t)(t >> 16);
+  mac16(iq_ii, i, i);
+  mac16(iq_qq, q, q);
+  mac16(iq_iq, i, q);
+  if (++iq_n < IQ_N) return;
+  iq_n = 0;
+  iq_snap[0] = iq_ii;
+  iq_snap[1] = iq_qq;
+  iq_snap[2] = iq_iq;
+  iq_seq++;
+  iq_ii = iq_qq = iq_iq = 0;
+}
+
+// update the I/Q balance coefficients from the last block (main loop)
+void RECV::iq_adapt() {
+  int32_t ii, qq, iq;
+  uint8_t s;
+  do {
+    s = iq_seq;
+    ii = iq_snap[0];
+    qq = iq_snap[1];
+    iq = iq_snap[2];
+  } while (s != iq_seq);
+  if (s == iq_seen) return;
+  iq_seen = s;
+  int32_t pw = ii + qq;
+  int32_t dg = ii - qq;
+  if (pw < IQ_MINPW) return;  // too weak
+  while (pw > 32767) {
+    pw >>= 1;
+    dg >>= 1;
+    iq >>= 1;
+  }
+  // normalized errors in Q15: dg/pw ~ gain error, iq/pw ~ sin(phase)/2
+  int32_t eg = (dg << 15) / pw;
+  int32_t ep = (iq << 15) / pw;
+  // steps of 1/8 and 1/4 of the error average out the tone ripple
+  int32_t g = iq_g - (eg >> 3);
+  int32_t p = iq_p - (ep >> 2);
+  g = min(max(g, -IQ_LIMIT), IQ_LIMIT);
+  p = min(max(p, -IQ_LIMIT), IQ_LIMIT);
+  iq_set(p, g);
+}
+
+// set the I/Q balance coefficients
+void RECV::iq_set(int16_t p, int16_t g) {
+  noInterrupts();
+  iq_p = p;
+  iq_g = g;
+  if (iqbal != OFF) {
+    iqk_p = p;
+    iqk_g = g;
+  }
+  interrupts();
+}
+
+// get the I/Q balance coefficients
+void RECV::iq_get(int16_t *p, int16_t *g) {
+  noInterrupts();
+  *p = iq_p;
+  *g = iq_g;
+  interrupts();
+}
+
+// agc kernel variants
+#define AGC_NONE  0   // no agc
+#define AGC_POST  1   // detect and apply after the filter
+#define AGC_LA    2   // detect before the hilb_i delay
+
+// sample processing kernel for one radio mode, agc setting and I/Q
+// balance on or off
+// returns the audio sample for the DAC upsampler (Q2)
+template<uint8_t MODE, uint8_t AGC, bool IQ>
+int16_t RECV::process_k(RECV *r, int16_t i, int16_t q) {
+  i >>= 2;
+  q >>= 2;
+  if (IQ) r->iq_balance(i, q);
+  if (AGC == AGC_LA) r->agc_lookahead(i);
+  int16_t qh = r->hilb_q(q);
+  int16_t ih = r->hilb_i(i);
+  int16_t ac = (MODE == USB) ? -(ih - qh) : -(ih + qh);
+  ac = r->filter(ac);
+  r->smeter_acc(ac);
+  if (AGC == AGC_POST) ac = r->apply_agc(ac);
+  if (AGC == AGC_LA) ac = r->agc_gain(ac);
+  ac = ac >> r->vshift;
+  return min(max(ac, -(1<<11)), (1<<11)-1 );
+}
+
+// indexed by [I/Q balance off/on][USB/LSB][agc kernel]
+const RECV::proc_t RECV::proc_bank[2][2][3] = {
+  {
+    { process_k<USB, AGC_NONE, 0>, process_k<USB, AGC_POST, 0>, process_k<USB, AGC_LA, 0> },
+    { process_k<LSB, AGC_NONE, 0>, process_k<LSB, AGC_POST, 0>, process_k<LSB, AGC_LA, 0> }
+  }, {
+    { process_k<USB, AGC_NONE, 1>, process_k<USB, AGC_POST, 1>, process_k<USB, AGC_LA, 1> },
+    { process_k<LSB, AGC_NONE, 1>, process_k<LSB, AGC_POST, 1>, process_k<LSB, AGC_LA, 1> }
+  }
+};
+
+// agc kernel for each agc mode
+static const uint8_t agc_kernel[] = { AGC_NONE, AGC_POST, AGC_POST, AGC_LA };
+
+// bandscope capture
+// start a bandscope capture into buf (2*FFT_N values)
+void RECV::scope_arm(int16_t *buf) {
+  scope_buf = buf;
+  scope_n = 0;
+}
+
+// bandscope capture complete
+bool RECV::scope_ready() {
+  return (scope_n == FFT_N);
+}
+
+// stop writing to the capture buffer
+void RECV::scope_stop() {
+  scope_n = FFT_N;
+}
+
+// add a decimated I/Q sample to an armed capture
+// shared by process(), capture() and process_block()
+inline void RECV::scope_put(int16_t i, int16_t q) {
+  if (scope_n < FFT_N) {
+    int16_t *p = &scope_buf[2*scope_n];
+    p[0] = i;
+    p[1] = q;
+    scope_n++;
+  }
 }
 
 // sample processing
 void RECV::process(int16_t i, int16_t q) {
-  static int16_t ac3;
   dac_upsample(ac3);
-  int16_t qh = hilb_q(q >> 2);
-  int16_t ih = hilb_i(i >> 2);
-  int16_t ac = (radiomode == USB) ? -(ih - qh) : -(ih + qh);
-  ac = filter(ac);
-  if (agc == FAST) ac = agc_fast(ac);
-  ac = ac >> (16 - volume);
-  ac3 = min(max(ac, -(1<<9)), (1<<9)-1 );
+  scope_put(i, q);
+  ac3 = proc(this, i, q);
+}
+
+#if DSP_MODE == DSP_BLOCK
+
+// block processing
+// the sample clock ISR captures decimated I/Q into one half of a
+// ping-pong buffer and takes audio from a FIFO; full blocks are
+// processed by process_blocks() with interrupts enabled
+
+// BLOCK_N and FIFO_N are in recv.h
+#define PRIME_N   (2*BLOCK_N)  // FIFO level before audio starts
+
+// capture a decimated I/Q sample and feed the DAC upsampler (ISR)
+void RECV::capture(int16_t i, int16_t q) {
+  // audio out
+  uint8_t r = fifo_r;
+  if (!primed) {
+    primed = (((fifo_w - r) & (FIFO_N-1)) >= PRIME_N);
+  } else if (r != fifo_w) {
+    ac3 = fifo[r];
+    fifo_r = (r + 1) & (FIFO_N-1);
+  } else {
+    underruns++;  // hold the last sample
+  }
+  dac_upsample(ac3);
+  // I/Q in
+  scope_put(i, q);
+  blk_i[blk_w][blk_pos] = i;
+  blk_q[blk_w][blk_pos] = q;
+  if (++blk_pos == BLOCK_N) {
+    blk_pos = 0;
+    if (blk_ready & (1 << (blk_w ^ 1))) {
+      overruns++;  // other buffer not processed yet: drop this one
+    } else {
+      blk_ready |= (1 << blk_w);
+      blk_w ^= 1;
+    }
+  }
+}
+
+// process the captured blocks
+// called at the end of the sample clock ISR, runs with interrupts
+// enabled so the sample clock and encoder ISRs can preempt it;
+// ac3 belongs to capture(), the kernel output goes straight to the FIFO
+void RECV::process_blocks() {
+  if (blk_busy || !blk_ready) return;
+  blk_busy = 1;
+  interrupts();
+  while (blk_ready) {
+    uint8_t b = (blk_ready & 1) ? 0 : 1;
+    const int16_t *bi = blk_i[b];
+    const int16_t *bq = blk_q[b];
+    proc_t p = proc;
+    uint8_t w = fifo_w;
+    for (uint8_t k = 0; k < BLOCK_N; k++) {
+      int16_t a = p(this, bi[k], bq[k]);
+      uint8_t nw = (w + 1) & (FIFO_N-1);
+      if (nw == fifo_r) {
+        overruns++;  // FIFO full
+        break;
+      }
+      fifo[w] = a;
+      w = nw;
+      fifo_w = w;
+    }
+    noInterrupts();
+    blk_ready &= ~(1 << b);
+    interrupts();
+  }
+  noInterrupts();
+  blk_busy = 0;
+}
+
+#endif
+
+// bind the processing kernels to the current settings
+// called when radiomode, agc, filterbw, iqbal or dacmode changes
+void RECV::configure() {
+  uint8_t m = (agc <= LOOK) ? agc : OFF;
+  proc_t p = proc_bank[iqbal != OFF][radiomode != USB][agc_kernel[m]];
+  noInterrupts();
+  proc = p;
+  agcp = agc_par[m];
+  iqk_p = (iqbal != OFF) ? iq_p : 0;
+  iqk_g = (iqbal != OFF) ? iq_g : 0;
+  set_filter(filterbw);
+  set_gain();
+  uint8_t d = (dacmode <= DAC_CIC3NS2) ? dacmode : DAC_CIC2;
+  if (d != dac_cur) {
+    dac_cur = d;
+    dac_comb = dac_comb_bank[d];
+    dac_load = dac_load_bank[d];
+    ocomb = ozi1 = ozi2 = ozi3 = 0;  // restart the interpolator
+    ozd1 = ozd2 = ozd3 = 0;
+    dac_r1 = dac_r2 = 0;
+  }
+  interrupts();
+}
+
+// set the gains of the current volume and dg_attn
+// byte stores, the ISR sees each one whole
+void RECV::set_gain() {
+  la_ofs = AGC_LA_OFS + 16 * dg_attn;
+  fgain = 11 - dg_attn;
+  vshift = 14 - volume;
 }
 
 // init ADC
 void RECV::init_adc() {
-  DIDR0 |= 0xc0; // disable digital input for ADC6 and ADC7
-  ADCSRA = 0x84; // ADEN=0x80 ADPS=0x04 (divide by 16)
-  ADCSRB = 0;    // enable with prescaler
+  hal_init_adc();
 }
 
 // init DAC
 void RECV::init_dac() {
-  TCCR1A = (1 << WGM11);
-  TCCR1B = (1 << CS10) | (1 << WGM13) | (1 << WGM12); // Mode 14 - Fast PWM
+  hal_init_dac();
 }
 
 // enable/disable DAC audio
 void RECV::set_dac_audio_enable(bool val) {
-  if (val) {
-    TCCR1A |= (1 << COM1A1);
-    pinMode(TONE, OUTPUT);
-  } else {
-    pinMode(TONE, INPUT);
-    TCCR1A &= ~(1 << COM1A1);
-  }
+  hal_dac_enable(val);
 }
 
 // PWM value range (fs>78431):  Fpwm = F_CPU / [Prescaler * (1 + TOP)]
 void RECV::set_dac_sample_rate(uint32_t fs) {
-  ICR1L = min(255, F_CPU / fs);
-  ICR1H = 0x00;
+  hal_dac_top(min(255, F_CPU / fs));
 }
 
 // init ADC and set sample rate
 void RECV::set_adc_sample_rate(uint16_t fs) {
-  ASSR &= ~(1 << AS2);               // timer2 clocked by the I/O clock
-  TCNT2 = 0;                         // clear the counter
-  TCCR2A = (1 << WGM21);             // mode 2 - clear on compare match
-  TCCR2B = (1 << CS22);              // 64 prescaler
-  OCR2A = ((F_CPU / 64) / fs) - 1;   // OCRn = (F_CPU / pre-scaler / fs) - 1;
-  TIMSK2 |= (1 << OCIE2A);           // enable TIMER2_COMPA interrupt
+  hal_adc_timer(((F_CPU / 64) / fs) - 1);   // OCRn = (F_CPU / pre-scaler / fs) - 1;
 }
 
 // returns unbiased ADC input
 int16_t RECV::get_adc(uint8_t adcpin) {
-  ADMUX = (adcpin - 14) | (1 << REFS1) | (1 << REFS0);
-  ADCSRA |= (1 << ADSC);
-  return ADC - 511;
+  return hal_adc_read(adcpin) - 511;
 }
 
 // sample interpolation by averaging
+// I is read one tick after Q; the mean of two I samples is the I
+// channel half an I sample (one tick) earlier, level with Q.  Without
+// it the skew is a phase error of 2*pi*f*16us, image rejection 26 dB
+// at 1 kHz and 17 dB at 3 kHz (radio_sim -M)
 int16_t RECV::sample_corr(int16_t ac) {
-  static int16_t prev_adc;
-  return (prev_adc + ac) / 2, prev_adc = ac;
+  int16_t a = ac + prev_adc;
+  prev_adc = ac;
+  return a >> 1;
 }
 
 void RECV::load_dac_audio() {
-  ozi1 = ocomb + ozi1;
-  ozi2 = ozi1 + ozi2;         // integrator section
-  OCR1AL = min(max((ozi2 >> 5) + 128, 0), 255);
+  dac_load(this);
 }
 
 // sample processing state machine
+// the sample clock alternates I (even rxstate) and Q (odd rxstate);
+// each channel is decimated by DSP_DECIM and the pair is processed when
+// the I decimator completes at rxstate 0, one tick after Q
 void RECV::sample_dsp() {
+  uint8_t s = rxstate;
   int16_t ac;
-  static int16_t c[13];
-  if (rxstate == 0) {
-    ac = sample_corr(get_adc(QSDI));
-    int16_t i_s1za0 = (ac + (c[0] + c[1]) * 3 + c[2]) >> 1;
-    c[0] = ac;
-    int16_t ac2 = (i_s1za0 + (c[3] + c[4]) * 3 + c[5]);
-    c[3] = i_s1za0;
-    process(ac2, c[12]);
-  } else if (rxstate == 1) {
-    ac = get_adc(QSDQ);
-    load_dac_audio();
-    c[8] = c[7];
-    c[7] = ac;
-  } else if (rxstate == 2) {
-    ac = sample_corr(get_adc(QSDI));
-    c[2] = c[1];
-    c[1] = ac;
-  } else if (rxstate == 3) {
-    ac = get_adc(QSDQ);
-    load_dac_audio();
-    c[11] = c[10];
-    c[10] = (ac + (c[6] + c[7]) * 3 + c[8]) >> 1;
-    c[6] = ac;
-  } else if (rxstate == 4) {
-    ac = sample_corr(get_adc(QSDI));
-    c[5] = c[4];
-    c[4] = (ac + (c[0] + c[1]) * 3 + c[2]) >> 1;
-    c[0] = ac;
-  } else if (rxstate == 5) {
-    ac = get_adc(QSDQ);
-    load_dac_audio();
-    c[8] = c[7];
-    c[7] = ac;
-  } else if (rxstate == 6) {
-    ac = sample_corr(get_adc(QSDI));
-    c[2] = c[1];
-    c[1] = ac;
-  } else if (rxstate == 7) {
+  if (s & 1) {
     ac = get_adc(QSDQ);
     load_dac_audio();
-    int16_t q_s1za0 = (ac + (c[6] + c[7]) * 3 + c[8]) >> 1;
-    c[6] = ac;
-    c[12] = (q_s1za0 + (c[9] + c[10]) * 3 + c[11]);
-    c[9] = q_s1za0;
+    if (qdec.put(ac, s >> 1)) qout = ac;
   } else {
-    rxstate=0;
+    ac = sample_corr(get_adc(QSDI));
+    if (idec.put(ac, (s >> 1) - 1)) {
+#if DSP_MODE == DSP_BLOCK
+      capture(ac, qout);
+#else
+      process(ac, qout);
+#endif
+    }
   }
-  rxstate++;
-  if (rxstate > 7) rxstate=0;
+  rxstate = (s + 1) & (2*DSP_DECIM - 1);
+}
+
+// bandwidth filter kernels, the coefficients are in filters.h
+// no bandwidth filter
+static int16_t fir_bypass(const int16_t *x, uint8_t gain) {
+  return x[0];
 }
 
-#define NTAPS 11
+// indexed by filterbw
+static const RECV::fir_t fir_bank[] = {
+  fir1500::run, fir2000::run, fir2500::run, firfull::run,
+  fir1000::run, fircw500::run, fircw300::run
+};
 
-// bandwidth filter FIR coefficients
-// calculated by WinFilter
+#define NFILTERS  (sizeof(fir_bank) / sizeof(fir_bank[0]))
+
+// bind the bandwidth filter kernel
+void RECV::set_filter(uint8_t bw) {
+  fir = (bw < NFILTERS) ? fir_bank[bw] : fir_bypass;
+}
+
+// power-up state: USB, no agc, no bandwidth filter, 2nd order CIC DAC
+// until configure() binds the settings
+RECV::RECV() {
+  proc = process_k<USB, AGC_NONE, 0>;
+  fir = fir_bypass;
+  dac_comb = dac_comb_k<2, 0>;
+  dac_load = dac_load_k<2, 0>;
+  agcp = agc_par[FAST];
+  scope_n = FFT_N;
+}
+
+// bandwidth filter
 int16_t RECV::filter(int16_t ac) {
-  uint16_t c[NTAPS];
-  uint8_t gain;
-  static int32_t x[NTAPS];
-  int32_t t;
-  int32_t y=0;
-  int16_t y2=0;
-
-  // shift samples
-  for(uint8_t n=NTAPS-1; n>0; n--) x[n] = x[n-1];
-  x[0] = ac;
-
-  switch (filterbw) {
-    case BW1500:
-      t = x[0]+x[10];                     // 0x006
-      y += (t<<2)+(t<<1);
-      t = x[1]+x[9];                      // 0x026
-      y -= (t<<5)+(t<<2)+(t<<1);
-      t = x[2]+x[8];                      // 0x074
-      y -= (t<<6)+(t<<5)+(t<<4)+(t<<2);
-      t = x[3]+x[7];                      // 0x01a
-      y += (t<<4)+(t<<3)+(t<<1);
-      t = x[4]+x[6];                      // 0x470
-      y += (t<<10)+(t<<6)+(t<<5)+(t<<4);
-      t = x[5];                           // 0x810
-      y += (t<<11)+(t<<4);
-      break;
-    case BW2000:
-      t = x[0]+x[10];                     // 0x003
-      y += (t<<1)+t;
-      t = x[1]+x[9];                      // 0x028
-      y += (t<<5)+(t<<3);
-      t = x[2]+x[8];                      // 0x03a
-      y -= (t<<5)+(t<<4)+(t<<3)+(t<<1);
-      t = x[3]+x[7];                      // 0x114
-      y -= (t<<8)+(t<<4)+(t<<2);
-      t = x[4]+x[6];                      // 0x430
-      y += (t<<10)+(t<<5)+(t<<4);
-      t = x[5];                           // 0x9e0
-      y += (t<<11)+(t<<8)+(t<<7)+(t<<6)+(t<<5);
-      break;
-    case BW2500:
-      t = x[0]+x[10];                     // 0x018
-      y -= (t<<4)+(t<<3);
-      t = x[1]+x[9];                      // 0x004
-      y -= (t<<2);
-      t = x[2]+x[8];                      // 0x090
-      y += (t<<7)+(t<<4);
-      t = x[3]+x[7];                      // 0x1e0
-      y -= (t<<8)+(t<<7)+(t<<6)+(t<<5);
-      t = x[4]+x[6];                      // 0x390
-      y += (t<<9)+(t<<8)+(t<<7)+(t<<4);
-      t = x[5];                           // 0xbc0
-      y += (t<<11)+(t<<9)+(t<<8)+(t<<7)+(t<<6);
-      break;
-    case BWFULL:
-      t = x[0]+x[10];                     // 0x0a8
-      y += (t<<7)+(t<<5)+(t<<3);
-      t = x[1]+x[9];                      // 0x0b8
-      y -= (t<<7)+(t<<5)+(t<<4)+(t<<3);
-      t = x[2]+x[8];                      // 0x0c6
-      y += (t<<7)+(t<<6)+(t<<2)+(t<<1);
-      t = x[3]+x[7];                      // 0x0d2
-      y -= (t<<7)+(t<<6)+(t<<4)+(t<<1);
-      t = x[4]+x[6];                      // 0x0da
-      y += (t<<7)+(t<<6)+(t<<4)+(t<<3)+(t<<1);
-      t = x[5];                           // 0xe80
-      y += (t<<11)+(t<<10)+(t<<9)+(t<<7);
-      break;
-    default:
-      return(ac);
-      break;
+  // insert sample, x[k] is k samples ago
+  uint8_t n = flt_n = (flt_n - 1) & 31;
+  flt_d[n] = flt_d[n+32] = ac;
+  return fir(&flt_d[n], fgain);
+}
+
+#ifndef __AVR__
+
+// host block processing
+// process() for n samples, with the Hilbert Q and bandwidth filter FIRs
+// run over a whole pass by the blk_kernels set (tools/recv_simd.cpp).
+// The delay lines are copied out of and back into their rings, so
+// blocks and single samples can be mixed.  The result is the same as
+// process() on every sample.
+
+#define BLK_N  256   // samples per pass
+
+// coefficients for the blk_kernels, indexed like fir_bank
+struct blk_fir_t {
+  const int16_t *coef;
+  uint8_t m;
+  bool fold16;
+};
+
+static const blk_fir_t blk_fir[] = {
+  { fir1500::coef, fir1500::M, false }, { fir2000::coef, fir2000::M, false },
+  { fir2500::coef, fir2500::M, false }, { firfull::coef, firfull::M, false },
+  { fir1000::coef, fir1000::M, false }, { fircw500::coef, fircw500::M, true },
+  { fircw300::coef, fircw300::M, true }
+};
+
+void RECV::process_block(const int16_t *bi, const int16_t *bq, int16_t *out, uint16_t n) {
+  int16_t vi[BLK_N];             // balanced I
+  int16_t xq[13 + BLK_N];        // Hilbert Q input, 13 old samples first
+  int16_t xf[31 + BLK_N];        // filter input, 2m old samples first
+  int16_t y[BLK_N];
+  uint8_t iq = 0, mode = 0, ak = 0;
+  for (uint8_t e = 0; e < 2; e++) {
+    for (uint8_t a = 0; a < 2; a++) {
+      for (uint8_t b = 0; b < 3; b++) {
+        if (proc_bank[e][a][b] == proc) {
+          iq = e;
+          mode = a;
+          ak = b;
+        }
+      }
+    }
+  }
+  int8_t f = -1;
+  for (uint8_t k = 0; k < NFILTERS; k++) {
+    if (fir_bank[k] == fir) f = k;
+  }
+  uint8_t m = (f < 0) ? 0 : blk_fir[f].m;
+  while (n) {
+    uint16_t nb = min(n, BLK_N);
+    // I/Q balance, bandscope capture
+    for (uint8_t k = 0; k < 13; k++) xq[k] = hq_d[hq_n + 12 - k];
+    for (uint16_t k = 0; k < nb; k++) {
+      scope_put(bi[k], bq[k]);
+      int16_t i = bi[k] >> 2;
+      int16_t q = bq[k] >> 2;
+      if (iq) iq_balance(i, q);
+      vi[k] = i;
+      xq[13 + k] = q;
+      hq_n = (hq_n - 1) & 15;
+      hq_d[hq_n] = hq_d[hq_n+16] = q;
+    }
+    // Hilbert transform and sideband
+    blk_kernels->hilb_q(xq, y, nb);
+    for (uint8_t k = 0; k < 2*m; k++) xf[k] = flt_d[flt_n + 2*m - 1 - k];
+    for (uint16_t k = 0; k < nb; k++) {
+      int16_t ih = hilb_i(vi[k]);
+      int16_t ac = (mode == 0) ? -(ih - y[k]) : -(ih + y[k]);
+      xf[2*m + k] = ac;
+      flt_n = (flt_n - 1) & 31;
+      flt_d[flt_n] = flt_d[flt_n+32] = ac;
+    }
+    // bandwidth filter
+    if (f < 0) {
+      memcpy(y, xf, nb * sizeof(int16_t));
+    } else {
+      blk_kernels->fir(xf, y, nb, blk_fir[f].coef, m, blk_fir[f].fold16, fgain);
+    }
+    // S-meter, AGC and volume
+    for (uint16_t k = 0; k < nb; k++) {
+      dac_upsample(ac3);
+      int16_t ac = y[k];
+      smeter_acc(ac);
+      if (ak == AGC_POST) ac = apply_agc(ac);
+      if (ak == AGC_LA) {
+        agc_lookahead(vi[k]);
+        ac = agc_gain(ac);
+      }
+      ac = ac >> vshift;
+      ac3 = min(max(ac, -(1<<11)), (1<<11)-1 );
+      out[k] = ac3;
+    }
+    bi += nb;
+    bq += nb;
+    out += nb;
+    n -= nb;
   }
-  gain = 11 - dg_attn;
-  y2 = y>>gain;
-  return(y2);
 }
 
+#endif
+
 #pragma GCC pop_options
 
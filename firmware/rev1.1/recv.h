@@ -1,17 +1,49 @@
-
 // ============================================================================
 //
 // recv.h   - SSB receiver library
 //
+// All the DSP state lives in the RECV object, so a host program can run
+// several independent receivers.  The firmware has one, driven from the
+// sample clock ISR.  The hot scalars are declared first: the AVR reaches
+// the first 64 bytes of the object with a displacement from its pointer.
+// On the AVR an instance takes 331 B of RAM, and the kernel and AGC
+// tables recv.cpp keeps in RAM 82 B more, shared by all instances
+// (clang/LLVM AVR build).
+//
 // ============================================================================
 
 #include <Arduino.h>
 #include <inttypes.h>
 #include "globals.h"
+#include "decim.h"
 
 #ifndef RECV_H
 #define RECV_H
 
+#define LEVEL_LOG2  5          // level reading: 2^LEVEL_LOG2 audio samples
+#define IQ_LIMIT    24576      // I/Q balance coefficient limit (+/-0.375)
+
+#if DSP_MODE == DSP_BLOCK
+#define BLOCK_N   8            // I/Q samples per block
+#define FIFO_N    32           // audio FIFO size (power of 2)
+#endif
+
+// audio samples an input takes to clear the delay lines: the decimator
+// (under 3), the Hilbert transform (13) and the longest bandwidth
+// filter (fircw300, 30); block processing holds two blocks more
+#if DSP_MODE == DSP_BLOCK
+#define RECV_SPAN   (46 + 2*BLOCK_N)
+#else
+#define RECV_SPAN   46
+#endif
+
+// AGC parameters
+struct agc_par_t {
+  uint8_t  attack;  // envelope attack shift
+  uint8_t  decay;   // envelope decay per sample (1/4096 octave)
+  uint16_t hang;    // hang time (samples)
+};
+
 class RECV {
   public:
     RECV();
@@ -19,7 +51,10 @@ class RECV {
     void end();
     int16_t hilb_i(int16_t);
     int16_t hilb_q(int16_t);
-    int16_t agc_fast(int16_t);
+    int16_t apply_agc(int16_t);
+    void agc_detect(uint8_t);
+    void agc_lookahead(int16_t);
+    int16_t agc_gain(int16_t);
     void dac_upsample(int16_t);
     void process(int16_t, int16_t);
     void init_adc();
@@ -32,8 +67,141 @@ class RECV {
     void load_dac_audio();
     void sample_dsp();
     int16_t filter(int16_t);
+    void set_filter(uint8_t);
+    void configure();
+    void set_gain();
+    int8_t smeter();
+    void scope_arm(int16_t *);
+    bool scope_ready();
+    void scope_stop();
+    void level_arm(uint8_t);
+    bool level_ready();
+    int8_t level();
+    void iq_adapt();
+    void iq_set(int16_t, int16_t);
+    void iq_get(int16_t *, int16_t *);
+    int16_t get_audio() { return ac3; }  // last audio sample, +/-2048 (Q2)
+#ifndef __AVR__
+    void process_block(const int16_t *, const int16_t *, int16_t *, uint16_t);
+#endif
+#if DSP_MODE == DSP_BLOCK
+    void capture(int16_t, int16_t);
+    void process_blocks();
+    volatile uint16_t underruns = 0;  // audio FIFO empty
+    volatile uint16_t overruns = 0;   // I/Q block or FIFO full
+#endif
+
+    // kernel types
+    typedef int16_t (*proc_t)(RECV *, int16_t, int16_t);
+    typedef int16_t (*fir_t)(const int16_t *, uint8_t);
+    typedef void (*dac_comb_t)(RECV *, int16_t);
+    typedef void (*dac_load_t)(RECV *);
+
+  private:
+    template<uint8_t MODE, uint8_t AGC, bool IQ>
+    static int16_t process_k(RECV *, int16_t, int16_t);
+    template<uint8_t ORDER, uint8_t SHAPE>
+    static void dac_comb_k(RECV *, int16_t);
+    template<uint8_t ORDER, uint8_t SHAPE>
+    static void dac_load_k(RECV *);
+    static const proc_t proc_bank[2][2][3];
+    static const dac_comb_t dac_comb_bank[];
+    static const dac_load_t dac_load_bank[];
+    void iq_balance(int16_t &, int16_t &);
+    void smeter_acc(int16_t);
+    void scope_put(int16_t, int16_t);
+
+    // active kernels, bound by configure()
+    proc_t     proc;
+    fir_t      fir;
+    dac_comb_t dac_comb;
+    dac_load_t dac_load;
+    uint8_t    fgain = 0;                 // filter output shift
+    uint8_t    vshift = 0;                // volume shift
+
+    // DAC interpolator
+    int16_t ac3 = 0;                      // audio sample for the DAC upsampler (Q2)
+    int16_t ocomb = 0, ozi1 = 0, ozi2 = 0, ozi3 = 0;
+    int16_t ozd1 = 0, ozd2 = 0, ozd3 = 0; // comb delays
+    uint8_t dac_r1 = 0, dac_r2 = 0;       // quantizer residue, last two samples
+    uint8_t dac_cur = DAC_CIC2;           // active dacmode
+
+    // ring buffer indices
+    uint8_t hi_n = 0, hq_n = 0, flt_n = 0;
 
+    // I/Q balance, sample kernel side
+    int16_t iqk_p = 0, iqk_g = 0;         // coefficients in use
+    int32_t iq_ii = 0, iq_qq = 0, iq_iq = 0;  // side path sums
+    uint8_t iq_n = 0;                     // side path sample count
+
+    // AGC
+    agc_par_t agcp;                       // active agc parameters
+    uint8_t  la_ofs = 0;                  // look-ahead level offset
+    uint16_t env = 0;                     // envelope (1/4096 octave)
+    uint16_t hang = 0;                    // hang counter
+
+    // S-meter
+    int32_t sm_acc = 0;                   // sum of squares
+    uint8_t sm_n = 0;                     // samples in the current block
+    volatile int32_t sm_snap = 0;         // last complete block
+    volatile uint8_t sm_seq = 0;          // bumped after each sm_snap update
+
+    // level reading (scanner)
+    int32_t lv_acc = 0;                   // sum of squares
+    uint8_t lv_skip = 0;                  // samples to drop first
+    volatile uint8_t lv_n = 0;            // samples still to add
+
+    // bandscope capture
+    int16_t *scope_buf = 0;               // interleaved I/Q
+    volatile uint8_t scope_n;             // samples captured
+
+    // sample clock state machine
+    Decim<DSP_DECIM> idec = {}, qdec = {};
+    int16_t qout = 0;                     // last decimated Q sample
+    int16_t prev_adc = 0;                 // sample_corr() state
+
+    // I/Q balance, main loop side
+    int16_t iq_p = 0, iq_g = 0;           // estimated coefficients
+    volatile int32_t iq_snap[3] = {};     // last complete block
+    volatile uint8_t iq_seq = 0;          // bumped after each iq_snap update
+    uint8_t iq_seen = 0;                  // iq_seq of the last adapted block
+
+    // delay lines
+    int16_t hi_v[8] = {};                 // hilb_i: matches the Hilbert transform delay
+    int16_t hq_d[32] = {};                // hilb_q, mirrored: d[n+k] is k samples ago
+    int16_t flt_d[64] = {};               // bandwidth filter, mirrored
+
+#if DSP_MODE == DSP_BLOCK
+    // block processing
+    int16_t blk_i[2][BLOCK_N] = {};
+    int16_t blk_q[2][BLOCK_N] = {};
+    uint8_t blk_w = 0;                    // buffer being captured
+    uint8_t blk_pos = 0;                  // capture position
+    volatile uint8_t blk_ready = 0;       // full buffers (bit mask)
+    volatile uint8_t blk_busy = 0;        // process_blocks() is running
+    int16_t fifo[FIFO_N] = {};            // audio FIFO
+    volatile uint8_t fifo_r = 0, fifo_w = 0;
+    uint8_t primed = 0;
+#endif
 };
 
+uint8_t log2q4(uint16_t);
+
+#ifndef __AVR__
+
+// host block kernels, implemented in tools/recv_simd.cpp
+// x holds the inputs oldest first, y[t] is the output for input x[t+span]
+struct blk_kernels_t {
+  const char *name;
+  // Hilbert Q of hilb_q(), span 13
+  void (*hilb_q)(const int16_t *x, int16_t *y, uint16_t n);
+  // symmetric FIR of FIR<> (fold16 false) or FIRMac<> (fold16 true), span 2m
+  void (*fir)(const int16_t *x, int16_t *y, uint16_t n, const int16_t *c, uint8_t m, bool fold16, uint8_t gain);
+};
+
+extern const blk_kernels_t *blk_kernels;      // set used by process_block()
+const blk_kernels_t *blk_select(const char *name);
+
 #endif
 
+#endif
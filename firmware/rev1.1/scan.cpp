@@ -0,0 +1,101 @@
+
+// ============================================================================
+//
+// scan.cpp   - band scanner
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "recv.h"
+#include "scan.h"
+
+// receiver to read, VFO tune function and the level table (SCAN_N
+// bytes, held from start() until clear())
+void SCAN::begin(RECV *r, tune_t t, int8_t *buf) {
+  rx = r;
+  tune = t;
+  lvl = buf;
+  clear();
+}
+
+// scan n channels (1..SCAN_N) from start in steps of step Hz,
+// at least dwell ms per channel
+void SCAN::start(int32_t start, int32_t step, uint8_t chans, uint16_t ms) {
+  list = 0;
+  f0 = start;
+  df = step;
+  n = min(max(chans, 1), SCAN_N);
+  nlvl = 0;
+  run = 1;
+  dwell = ms;
+  k = 0;
+  armed = 0;
+  sweeps = 0;
+  sweep_ms = 0;
+  for (uint8_t c = 0; c < SCAN_N; c++) lvl[c] = -128;
+}
+
+// scan the n frequencies of f[] (RAM, kept by the caller)
+void SCAN::start_list(const int32_t *f, uint8_t chans, uint16_t ms) {
+  start(0, 0, chans, ms);
+  list = f;
+}
+
+// stop scanning; the levels read so far stay for SD
+void SCAN::stop() {
+  run = 0;
+}
+
+// stop and drop the levels, before the table is used for something else
+void SCAN::clear() {
+  run = 0;
+  n = 0;
+  nlvl = 0;
+}
+
+// frequency of channel c
+int32_t SCAN::freq(uint8_t c) {
+  if (list) return list[c];
+  return f0 + c * df;
+}
+
+// one piece of the scan; returns 1 when a sweep has just completed
+uint8_t SCAN::step(uint32_t now) {
+  uint8_t done = 0;
+  if (!run) return 0;
+  if (armed) {
+    if (!rx->level_ready() || ((now - t_ch) < dwell)) return 0;
+    lvl[k] = rx->level();
+    armed = 0;
+    if (k >= nlvl) nlvl = k + 1;
+    if (++k >= n) {
+      k = 0;
+      sweep_ms = min(now - t_sweep, 0xffffUL);
+      sweeps++;
+      done = 1;
+    }
+  }
+  // tune the next channel and start its level reading
+  if (!k) t_sweep = now;
+  tune(freq(k));
+  rx->level_arm(SCAN_SETTLE);
+  t_ch = now;
+  armed = 1;
+  return done;
+}
+
+// strongest channel of the last sweep
+uint8_t SCAN::peak() {
+  uint8_t p = 0;
+  for (uint8_t c = 1; c < nlvl; c++) {
+    if (lvl[c] > lvl[p]) p = c;
+  }
+  return p;
+}
+
+// channels per second of the last sweep, x10
+uint16_t SCAN::rate() {
+  if (!sweep_ms) return 0;
+  return (uint32_t)n * 10000 / sweep_ms;
+}
@@ -0,0 +1,67 @@
+
+// ============================================================================
+//
+// scan.h   - band scanner
+//
+// Steps the VFO through a range (start, step, channels) or a list of
+// frequencies.  Per channel: retune through the tune function (the
+// cheapest SI5351 path, no PLL reset inside a band), let the decimator,
+// Hilbert and filter delay lines refill, read the level of the
+// demodulated audio for 2^LEVEL_LOG2 samples (RECV::level_arm()) and
+// stay for at least the dwell time.  step() does one piece of that per
+// call, so the main loop never waits on the DSP and the sample clock
+// ISR is never held off.  Levels are kept in dB, one byte per channel,
+// in a table the caller lends (hfrx.ino: the bandscope buffer, which is
+// idle while a scan runs).  stop() keeps the levels; clear() drops them
+// when the table goes back to its owner.
+//
+// The level is read from the bandwidth filter output ahead of the AGC,
+// so the settle after a retune is the span of the delay lines
+// (RECV_SPAN) and does not wait on the AGC envelope.
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "recv.h"
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#define SCAN_N       64    // channels, at most
+#define SCAN_SETTLE  RECV_SPAN  // audio samples dropped after a retune
+
+class SCAN {
+  public:
+    typedef void (*tune_t)(int32_t);
+    void begin(RECV *, tune_t, int8_t *);
+    void start(int32_t, int32_t, uint8_t, uint16_t);
+    void start_list(const int32_t *, uint8_t, uint16_t);
+    void stop();
+    void clear();
+    bool active() { return run != 0; }
+    uint8_t step(uint32_t);
+    int32_t freq(uint8_t);
+    uint8_t peak();
+    uint16_t rate();
+
+    int8_t  *lvl = 0;         // level per channel (dB, as RECV::smeter()), SCAN_N
+    uint8_t  n = 0;           // channels of the last scan, kept after stop()
+    uint8_t  nlvl = 0;        // channels with a level (n after the first sweep)
+    uint16_t dwell = 0;       // least time per channel (ms)
+    uint16_t sweep_ms = 0;    // last complete sweep (ms)
+    uint16_t sweeps = 0;      // complete sweeps
+
+  private:
+    RECV    *rx = 0;
+    tune_t   tune = 0;
+    const int32_t *list = 0;  // frequency list, or
+    int32_t  f0 = 0, df = 0;  // start and step
+    uint8_t  run = 0;         // scanning
+    uint8_t  k = 0;           // channel being read
+    uint8_t  armed = 0;       // channel k tuned, level reading started
+    uint32_t t_ch = 0;        // channel k tuned (ms)
+    uint32_t t_sweep = 0;     // sweep started (ms)
+};
+
+#endif
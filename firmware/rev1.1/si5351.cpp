@@ -11,26 +11,114 @@
 extern I2C0 i2c0;
 
 // frequency calculations
-inline void FAST SI5351::freq_calc_fast(int16_t df) {
+// MSNA fraction b = r*MSC/fxtal of a VCO remainder r < fxtal: a 16 step
+// long division, no 64-bit math, the same b as ms().
+inline uint16_t SI5351::frac(uint32_t r) {
   #define _MSC  0x10000
-  uint32_t msb128 = _msb128 + ((int64_t)(_div * (int32_t)df) * _MSC * 128) / fxtal;
-  uint16_t msp1 = _msa128min512 + msb128 / _MSC;
-  uint16_t msp2 = msb128;
-  // pll_regs[3:0] do not change
+  uint16_t b = 0;
+  for (uint8_t k = 0; k < 16; k++) {
+    r <<= 1;
+    b <<= 1;
+    if (r >= fxtal) {
+      r -= fxtal;
+      b |= 1;
+    }
+  }
+  return b;
+}
+
+// MSNA bytes for a VCO remainder r = d*fout % fxtal over the integer
+// part msa = 128*a-512.  P3 is 0x10000 and P1 < 0x10000, so pll_regs[2:0]
+// stay as sent.
+inline void OFAST SI5351::freq_calc_fast(uint32_t r, uint16_t msa) {
+  uint16_t b = frac(r);
+  uint16_t msp1 = msa + (b >> 9);
+  uint16_t msp2 = b << 7;
+  pll_regs[3] = BB1(msp1);
   pll_regs[4] = BB0(msp1);
   pll_regs[5] = ((_MSC&0xF0000)>>12);
   pll_regs[6] = BB1(msp2);
   pll_regs[7] = BB0(msp2);
 }
 
+// send the MSNA bytes that changed, in one burst
+inline void SI5351::SendPLLRegister() {
+  SendRegister(29, (uint8_t *)&pll_regs[3], 5);
+  flush();
+}
+
+// ----------------------------------------------------------------------------
+// register shadow
+// ----------------------------------------------------------------------------
+
+// shadow index of a register, 0xff if not kept
+static inline uint8_t sh_index(uint8_t reg) {
+  if (reg == 3) return 0;
+  if ((reg >= 16) && (reg <= 65)) return reg - 15;
+  if ((reg >= 165) && (reg <= 167)) return reg - 114;
+  return 0xff;
+}
+
+#define SH_TEST(m, i)  ((m)[(i) >> 3] & (1 << ((i) & 7)))
+#define SH_SET(m, i)   ((m)[(i) >> 3] |= (1 << ((i) & 7)))
+#define SH_CLR(m, i)   ((m)[(i) >> 3] &= ~(1 << ((i) & 7)))
+
 // send register with 3 args
+// Kept registers go to the shadow and are marked dirty when they
+// change; flush() sends them.  Others are sent at once, after a flush
+// so that the order of the writes stays.
 void SI5351::SendRegister(uint8_t reg, uint8_t* data, uint8_t n) {
-  i2c0.write(SI5351_ADDR, reg, data, n);
+  uint8_t direct = 0;
+  for (uint8_t k = 0; k < n; k++) if (sh_index(reg+k) == 0xff) direct = 1;
+  if (direct) flush();
+  req_bytes += n;
+  req_writes++;
+  for (uint8_t k = 0; k < n; k++) {
+    uint8_t i = sh_index(reg+k);
+    if ((i == 0xff) || (SH_TEST(sh_valid, i) && (shadow[i] == data[k]))) continue;
+    shadow[i] = data[k];
+    SH_SET(sh_valid, i);
+    if (!direct) SH_SET(sh_dirty, i);
+  }
+  if (direct) {
+    i2c0.write(SI5351_ADDR, reg, data, n);
+    sent_bytes += n;
+    sent_writes++;
+  }
 }
 
 // send register with 2 args
 void SI5351::SendRegister(uint8_t reg, uint8_t data) {
-  i2c0.write(SI5351_ADDR, reg, data);
+  SendRegister(reg, &data, 1);
+}
+
+// Send the dirty registers, one burst per run.  Up to SI5351_GAP clean
+// registers inside a run are sent again: 9 bit times each, where a new
+// transaction costs about 20 (start, address, register, stop).
+void SI5351::flush() {
+  static const uint8_t seg[3][3] = {   // first register, shadow index, length
+    { 3, 0, 1 }, { 16, 1, 50 }, { 165, 51, 3 }
+  };
+  for (uint8_t s = 0; s < 3; s++) {
+    uint8_t i0 = seg[s][1], n = seg[s][2];
+    uint8_t k = 0;
+    while (k < n) {
+      if (!SH_TEST(sh_dirty, i0+k)) {
+        k++;
+        continue;
+      }
+      uint8_t hi = k;
+      for (uint8_t j = k+1; j < n; j++) {
+        if (SH_TEST(sh_dirty, i0+j)) hi = j;
+        else if (!SH_TEST(sh_valid, i0+j) || (j - hi > SI5351_GAP)) break;
+      }
+      for (uint8_t j = k; j <= hi; j++) SH_CLR(sh_dirty, i0+j);
+      i2c0.write(SI5351_ADDR, seg[s][0]+k, &shadow[i0+k], hi-k+1);
+      sent_bytes += hi-k+1;
+      sent_writes++;
+      k = hi+1;
+    }
+  }
 }
 
 // read register
@@ -40,21 +128,27 @@ uint8_t SI5351::ReadRegister(uint8_t reg) {
 }
 
 void SI5351::ms(int8_t n, uint32_t div_nom, uint32_t div_denom, uint8_t pll = PLLA, uint8_t _int = 0, uint16_t phase = 0, uint8_t rdiv = 0) {
-  uint16_t msa; uint32_t msb, msc, msp1, msp2, msp3;
+  uint16_t msa; uint32_t msb;
   // integer part
   msa = div_nom / div_denom;
   // MS divider of 4 and integer mode must be used
   if (msa == 4) _int = 1;
   // fractional part
   msb = _int ? 0 : (((uint64_t)(div_nom % div_denom)*_MSC) / div_denom);
-  msc = _int ? 1 : _MSC;
-  msp1 = 128*msa + 128*msb/msc - 512;
-  msp2 = 128*msb - 128*msb/msc * msc;
-  msp3 = msc;
+  msx(n, msa, msb, pll, _int, phase, rdiv);
+}
+
+// write MSx from its integer part msa and fraction msb/_MSC
+void SI5351::msx(int8_t n, uint16_t msa, uint16_t msb, uint8_t pll = PLLA, uint8_t _int = 0, uint16_t phase = 0, uint8_t rdiv = 0) {
+  uint32_t msp1, msp2, msp3;
+  // 128*msb/msc is msb>>9, the rest of 128*msb goes to msp2
+  msp1 = 128*msa + ((uint32_t)msb >> 9) - 512;
+  msp2 = (uint16_t)((uint32_t)msb << 7);
+  msp3 = _int ? 1 : _MSC;
   uint8_t ms_regs[8] = {
     BB1(msp3),
     BB0(msp3),
-    BB2(msp1) | (rdiv<<4) | ((msa == 4)*0x0C),
+    (uint8_t)(BB2(msp1) | (rdiv<<4) | ((msa == 4)*0x0C)),
     BB1(msp1),
     BB0(msp1),
     BB2(((msp3 & 0x0F0000)<<4) | msp2),
@@ -78,7 +172,7 @@ void SI5351::phase(int8_t n, uint32_t div_nom, uint32_t div_denom, uint16_t phas
   SendRegister(n+165, phase * (div_nom / div_denom) / 90);
 }
 
-// 0x20 reset PLLA; 0x80 reset PLLB
+// 0x20 reset PLLA; 0x80 reset PLLB (not kept, so the staged writes go first)
 void SI5351::reset() {
   SendRegister(177, 0xA0);
 }
@@ -86,15 +180,11 @@ void SI5351::reset() {
 // output-enable mask: CLK2=4; CLK1=2; CLK0=1
 void SI5351::oe(uint8_t mask) {
   SendRegister(3, ~mask);
+  flush();
 }
 
-// Set a CLK0,1,2 to fout Hz with phase i, q (on PLLA)
-void SI5351::freq(int32_t fout, uint16_t i, uint16_t q) {
-  uint8_t rdiv = 0;
-  // for higher freqs, use 3rd harmonic
-  if (fout > 300000000) { i/=3; q/=3; fout/=3; }
-  // divide by 128 for fout 4..500kHz
-  if (fout < 500000) { rdiv = 7; fout *= 128; }
+// output divider for fout (after the R divider and 3rd harmonic)
+uint16_t SI5351::divider(int32_t fout) {
   // integer part  .. maybe 44?
   uint16_t d;
   if (fout < 30000000) d = (16 * fxtal) / fout;
@@ -107,6 +197,36 @@ void SI5351::freq(int32_t fout, uint16_t i, uint16_t q) {
   // Test if multiplier remains same for freq deviation +/- 5kHz
   // if not use different divider to make same
   if ( (d * (fout - 5000) / fxtal) != (d * (fout + 5000) / fxtal) ) d += 2;
+  return d;
+}
+
+// PLL reset when the CLK0/CLK1 phase offset changes, output enable,
+// and the new base of the fast tune window
+void SI5351::tuned(int32_t fout, uint16_t d, uint16_t a, uint32_t r, uint16_t i, uint16_t q) {
+  if (iqmsa != (((int8_t)i-(int8_t)q)*((int16_t)d)/90)) {
+    iqmsa = ((int8_t)i-(int8_t)q)*((int16_t)d)/90;
+    reset();
+  }
+  // output enable CLK0, CLK1
+  oe(0b00000011);
+  _fout = fout;
+  _div = d;
+  _msa128min512 = a * 128 - 512;
+  _msr = r;
+}
+
+// Set a CLK0,1,2 to fout Hz with phase i, q (on PLLA)
+void SI5351::freq(int32_t fout, uint16_t i, uint16_t q) {
+  uint8_t rdiv = 0;
+  // no fast tuning with the 3rd harmonic or the R divider
+  _fast = (fout >= 500000) && (fout <= 300000000);
+  _i = i;
+  _q = q;
+  // for higher freqs, use 3rd harmonic
+  if (fout > 300000000) { i/=3; q/=3; fout/=3; }
+  // divide by 128 for fout 4..500kHz
+  if (fout < 500000) { rdiv = 7; fout *= 128; }
+  uint16_t d = divider(fout);
   // Variable PLLA VCO frequency at integer multiple
   // of fout at around 27MHz*16 = 432MHz
   // spectral purity considerations
@@ -119,16 +239,163 @@ void SI5351::freq(int32_t fout, uint16_t i, uint16_t q) {
   ms(MS0,  fvcoa, fout, PLLA, 0, i, rdiv);
   ms(MS1,  fvcoa, fout, PLLA, 0, q, rdiv);
   ms(MS2,  fvcoa, fout, PLLA, 0, 0, rdiv);
-  if (iqmsa != (((int8_t)i-(int8_t)q)*((int16_t)(fvcoa/fout))/90)) {
-    iqmsa = ((int8_t)i-(int8_t)q)*((int16_t)(fvcoa/fout))/90;
-    reset();
+  tuned(fout, d, fvcoa / fxtal, fvcoa % fxtal, i, q);
+}
+
+// Set the bands of the band table for the current fxtal.  edge[]
+// (PROGMEM) holds n pairs of band edges in Hz, ascending.  The table
+// itself is built for one band at a time, by freq_fast() on a retune
+// into another band.
+void SI5351::plan(const int32_t *edge, uint8_t n) {
+  bands = edge;
+  nbands = n;
+  plan_fxtal = fxtal;
+  nseg = 0;
+  _seg = 0;
+  _band = 0xff;
+}
+
+// band of fout, -1 if not in a band
+int8_t SI5351::band_find(int32_t fout) {
+  for (uint8_t k = 0; k < nbands; k++) {
+    if ((fout >= (int32_t)pgm_read_dword(&bands[2*k])) &&
+        (fout <= (int32_t)pgm_read_dword(&bands[2*k+1]))) return k;
   }
-  // output enable CLK0, CLK1
-  oe(0b00000011);
-  _fout = fout;
-  _div = d;
-  _msa128min512 = fvcoa / fxtal * 128 - 512;
-  _msb128=((uint64_t)(fvcoa % fxtal)*_MSC*128) / fxtal;
+  return -1;
+}
+
+// Build the band table of band k for the current fxtal.  The band is
+// walked from one change of d or a to the next: the next step of each
+// floor in divider() and of a = d*f/fxtal.  A band that does not fit
+// leaves the table empty and tunes with freq().
+void SI5351::plan_band(uint8_t k) {
+  _band = k;
+  nseg = 0;
+  _seg = 0;
+  int32_t f = pgm_read_dword(&bands[2*k]);
+  int32_t hi = pgm_read_dword(&bands[2*k+1]);
+  // no R divider, 3rd harmonic or integer mode, d fits 8 bits
+  if (f < 1000000) f = 1000000;
+  if (hi > 140000000) hi = 140000000;
+  if (f > hi) return;
+  while (f <= hi) {
+    uint16_t d = divider(f);
+    uint16_t a = (uint32_t)d * f / fxtal;
+    // next step of d: of c*fxtal/f, at 3.5 and 30 MHz, of the window test
+    uint8_t c = (f < 3500000) ? 7 : (f < 30000000) ? 16 : 32;
+    uint16_t dc = c * fxtal / f;
+    uint32_t nf = c * fxtal / dc + 1;
+    if ((f < 3500000) && (nf > 3500000)) nf = 3500000;
+    if ((f < 30000000) && (nf > 30000000)) nf = 30000000;
+    uint16_t de = dc + (dc & 1);
+    uint32_t m = (uint32_t)de * (f - 5000) / fxtal + 1;
+    uint32_t t = (m * fxtal + de - 1) / de + 5000;
+    if (t < nf) nf = t;
+    m = (uint32_t)de * (f + 5000) / fxtal + 1;
+    t = (m * fxtal + de - 1) / de - 5000;
+    if (t < nf) nf = t;
+    // next step of a
+    t = ((uint32_t)(a + 1) * fxtal + d - 1) / d;
+    if (t < nf) nf = t;
+    if (!nseg || (seg[nseg-1].d != d) || (seg[nseg-1].a != a)) {
+      if (nseg + 2 > SI5351_SEGS) {
+        // full: no table for this band
+        nseg = 0;
+        return;
+      }
+      seg[nseg].f = f;
+      seg[nseg].d = d;
+      seg[nseg].a = a;
+      nseg++;
+    }
+    f = nf;
+  }
+  // end of band
+  seg[nseg].f = hi + 1;
+  seg[nseg].d = 0;
+  seg[nseg].a = 0;
+  nseg++;
+}
+
+// band table segment of fout, -1 if not in a band
+int8_t SI5351::seg_find(int32_t fout) {
+  uint8_t k = (_seg < nseg) ? _seg : 0;
+  while ((k > 0) && (seg[k].f > fout)) k--;
+  while ((k + 1 < nseg) && (seg[k+1].f <= fout)) k++;
+  _seg = k;
+  if (!nseg || (seg[k].f > fout) || !seg[k].d) return -1;
+  return k;
+}
+
+// In-band retune from segment s of the band table: the registers of
+// freq() from 32-bit multiplies and frac().
+void SI5351::freq_seg(int32_t fout, uint8_t s, uint16_t i, uint16_t q) {
+  uint16_t d = seg[s].d, a = seg[s].a;
+  uint32_t r = d * (uint32_t)fout - a * fxtal;
+  msx(MSNA, a, frac(r), PLLA, 0, 0, 0);
+  msx(MS0, d, 0, PLLA, 0, i, 0);
+  msx(MS1, d, 0, PLLA, 0, q, 0);
+  msx(MS2, d, 0, PLLA, 0, 0, 0);
+  _fast = 1;
+  _i = i;
+  _q = q;
+  tuned(fout, d, a, r, i, q);
+}
+
+// Retune CLK0..CLK2.  In a band of the band table (rebuilt for the
+// band of fout and when fxtal has changed) the registers of freq()
+// without a division.  Else
+// within +/-5 kHz of the last retune the output dividers, the phase
+// offsets and the integer part of MSNA stay, so only the MSNA fraction
+// is sent and there is no PLL reset.  Outside the window, or for other
+// phases, a full freq().  CPU per 10 Hz detent at 7074 kHz (make
+// retune-bench, clang/LLVM AVR build): freq() 25600 cycles (1.3 ms),
+// window 5460, band table 12250, band change and rebuild 165000 (8.3 ms).
+void SI5351::freq_fast(int32_t fout, uint16_t i, uint16_t q) {
+  if (nbands && (plan_fxtal != fxtal)) plan(bands, nbands);
+  if (nbands && (!nseg || (fout < seg[0].f) || (fout >= seg[nseg-1].f))) {
+    int8_t b = band_find(fout);
+    if ((b >= 0) && (b != _band)) plan_band(b);
+  }
+  int8_t s = seg_find(fout);
+  if (s >= 0) {
+    freq_seg(fout, s, i, q);
+    return;
+  }
+  int32_t df = fout - _fout;
+  int32_t r = _msr + (int32_t)_div * df;
+  if (!_fast || (i != _i) || (q != _q) || (df < -5000) || (df > 5000) || (r < 0) || (r >= (int32_t)fxtal)) {
+    freq(fout, i, q);
+    return;
+  }
+  freq_calc_fast(r, _msa128min512);
+  SendPLLRegister();
+}
+
+// Move CLK0..CLK2 to fout with the MSNA alone (RIT): the output
+// dividers and phase offsets of the last retune stay and the VCO goes
+// to d*fout, so the PLL is not reset and CLK1 stays 90 degrees behind
+// CLK0.  The integer part of MSNA may step, unlike the fast tune
+// window.  Without a fast tune base, after a change of fxtal or more
+// than 20 kHz from the last retune it is a freq_fast().
+void SI5351::freq_pll(int32_t fout) {
+  int32_t df = fout - _fout;
+  if (!_fast || (nbands && (plan_fxtal != fxtal)) || (df < -20000) || (df > 20000)) {
+    freq_fast(fout, _i, _q);
+    return;
+  }
+  int32_t r = _msr + (int32_t)_div * df;
+  uint16_t msa = _msa128min512;
+  while (r < 0) {
+    r += fxtal;
+    msa -= 128;
+  }
+  while (r >= (int32_t)fxtal) {
+    r -= fxtal;
+    msa += 128;
+  }
+  freq_calc_fast(r, msa);
+  SendPLLRegister();
 }
 
 // Set a CLK2 to fout Hz (on PLLB)
@@ -141,6 +408,7 @@ void SI5351::freqb(uint32_t fout) {
   uint32_t fvcoa = d * fout;
   ms(MSNB, fvcoa, fxtal);
   ms(MS2,  fvcoa, fout, PLLB, 0, 0, 0);
+  flush();
 }
 
 void SI5351::stop() {
@@ -151,5 +419,6 @@ void SI5351::stop() {
   SendRegister(187, 0);
   SendRegister(149, 0);
   SendRegister(183, 0b11010010);
+  flush();
 }
 
@@ -14,14 +14,52 @@
 
 #define SI5351_ADDR   0x60
 
+// Register shadow: registers 3, 16..65 and 165..167 are sent only when
+// they change (SI5351::flush()).  Runs of changed registers with up to
+// SI5351_GAP unchanged ones between them go in one burst.
+#define SI5351_SHADOW 54
+#define SI5351_GAP    2
+
+// Band table: SI5351::plan_band() splits the band of the dial into
+// segments of the same output divider d and MSNA integer part a as
+// freq() picks them, so an in-band retune needs no division.  It is
+// built again when the band or fxtal changes.  6 bytes per entry; of
+// the HF bands of hfrx.ino 80 m takes the most, 24 segments and the
+// end entry over the calibration range (make retune-check).
+#define SI5351_SEGS   25
+
+struct si5351_seg_t {
+  int32_t f;          // first frequency of the segment (Hz)
+  uint8_t d;          // output divider, 0 past the end of a band
+  uint8_t a;          // MSNA integer part
+};
+
 class SI5351 {
 public:
 
-  volatile int32_t  _fout;
-  volatile uint8_t  _div;
-  volatile uint16_t _msa128min512;
-  volatile uint32_t _msb128;
-  volatile uint8_t  pll_regs[8];
+  volatile int32_t  _fout;           // last full retune, centre of the fast tune window
+  volatile uint16_t _div;            // output divider d
+  volatile uint16_t _msa128min512;   // MSNA P1 integer part
+  volatile uint32_t _msr;            // VCO remainder, d*fout % fxtal
+  volatile uint16_t _i, _q;          // CLK0, CLK1 phase of the last full retune
+  volatile uint8_t  _fast;           // fast tune window valid
+  volatile uint8_t  pll_regs[8];     // MSNA registers of freq_calc_fast()
+
+  uint8_t  shadow[SI5351_SHADOW];            // registers as sent
+  uint8_t  sh_valid[(SI5351_SHADOW+7)/8];    // register known
+  uint8_t  sh_dirty[(SI5351_SHADOW+7)/8];    // register to send
+  uint32_t req_bytes;                        // register bytes written by the driver
+  uint32_t req_writes;                       // SendRegister() calls, each a transaction without the shadow
+  uint32_t sent_bytes;                       // register bytes sent on the bus
+  uint32_t sent_writes;                      // I2C transactions
+
+  si5351_seg_t seg[SI5351_SEGS];             // band table, by frequency
+  uint8_t  nseg;
+  uint8_t  _seg;                             // segment of the last lookup
+  const int32_t *bands;                      // band edges (PROGMEM)
+  uint8_t  nbands;
+  uint8_t  _band;                            // band of the table
+  uint32_t plan_fxtal;                       // fxtal of the band table
   volatile uint32_t fxtal;
   volatile int32_t  fxadj;
 
@@ -33,21 +71,33 @@ public:
   #define BB1(x) ((uint8_t)((x)>>8))
   #define BB2(x) ((uint8_t)((x)>>16))
 
-  #define FAST __attribute__((optimize("Ofast")))
+  #define OFAST __attribute__((optimize("Ofast")))
 
-  inline void FAST freq_calc_fast(int16_t df);
+  inline uint16_t frac(uint32_t);
+  inline void OFAST freq_calc_fast(uint32_t, uint16_t);
   inline void SendPLLRegister();
 
   void i2c_write(uint8_t, uint8_t, uint8_t);
   void bulk_write(uint8_t, uint8_t, uint8_t*, uint8_t);
   void SendRegister(uint8_t, uint8_t*, uint8_t);
   void SendRegister(uint8_t, uint8_t);
+  void flush();
   uint8_t ReadRegister(uint8_t);
   void ms(int8_t, uint32_t, uint32_t, uint8_t, uint8_t, uint16_t, uint8_t);
+  void msx(int8_t, uint16_t, uint16_t, uint8_t, uint8_t, uint16_t, uint8_t);
   void phase(int8_t, uint32_t, uint32_t, uint16_t);
   void reset();
   void oe(uint8_t);
+  uint16_t divider(int32_t);
+  void tuned(int32_t, uint16_t, uint16_t, uint32_t, uint16_t, uint16_t);
   void freq(int32_t, uint16_t, uint16_t);
+  void plan(const int32_t*, uint8_t);
+  void plan_band(uint8_t);
+  int8_t band_find(int32_t);
+  int8_t seg_find(int32_t);
+  void freq_seg(int32_t, uint8_t, uint16_t, uint16_t);
+  void freq_fast(int32_t, uint16_t, uint16_t);
+  void freq_pll(int32_t);
   void freqb(uint32_t);
   void stop();
 
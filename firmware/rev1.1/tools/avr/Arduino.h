@@ -0,0 +1,45 @@
+
+// ============================================================================
+//
+// Arduino.h   - minimal AVR stand-in for the Arduino core
+//
+// Lets recv.cpp, prof.cpp and hal.h build for the simulator benchmarks
+// without the Arduino core. Pin setup is not needed there.
+//
+// ============================================================================
+
+#ifndef ARDUINO_H_AVR
+#define ARDUINO_H_AVR
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define INPUT    0x0
+#define OUTPUT   0x1
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+#define pinMode(pin, mode)
+#define noInterrupts() cli()
+#define interrupts()   sei()
+
+// Serial prints on stdout (the simavr console), F() strings stay in RAM
+struct SerialCon {
+  void print(const char *s) { fputs(s, stdout); }
+  void print(char c) { putchar(c); }
+  void print(int v) { printf("%d", v); }
+  void print(unsigned int v) { printf("%u", v); }
+  void print(long v) { printf("%ld", v); }
+  void print(unsigned long v) { printf("%lu", v); }
+};
+
+static SerialCon Serial;
+
+#define F(s)  (s)
+
+#endif
@@ -0,0 +1,50 @@
+// ============================================================================
+//
+// sim.h   - simavr console, exit and test data for the AVR tool builds
+//
+// Include once, from the program's own source: it also places the
+// simavr MCU description.
+//
+// ============================================================================
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "simavr/avr/avr_mcu_section.h"
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+// write console output to the simavr console register
+static int con_putc(char c, FILE *stream) {
+  GPIOR0 = c;
+  return 0;
+}
+
+// send stdout to the simavr console
+static inline void sim_console() {
+  static FILE con;
+  fdev_setup_stream(&con, con_putc, NULL, _FDEV_SETUP_WRITE);
+  stdout = &con;
+}
+
+// end the simulation: sleeping with interrupts off
+static inline void sim_exit() {
+  cli();
+  sleep_enable();
+  sleep_cpu();
+  for (;;);
+}
+
+// 16-bit Galois LFSR
+static inline int16_t rnd() {
+  static uint16_t lfsr = 0xace1;
+  lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xb400);
+  return lfsr;
+}
+
+#endif
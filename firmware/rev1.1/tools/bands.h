@@ -0,0 +1,31 @@
+// ============================================================================
+//
+// bands.h   - the bands of hfrx.ino for the host tools
+//
+// Copies of bandfreq[] and bandedge[] in hfrx.ino; keep them the same.
+//
+// ============================================================================
+
+#ifndef BANDS_H
+#define BANDS_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define NBANDS  9
+
+static const int32_t bandfreq[] = {
+  3573000,  5357000,  7074000,  10136000, 14074000,
+  18100000, 21074000, 24915000, 28074000
+};
+
+// band edges for the si5351 band table (Hz)
+static const int32_t bandedge[] PROGMEM = {
+  3500000,  4000000,  5250000,  5450000,  7000000,  7300000,
+  10100000, 10150000, 14000000, 14350000, 18068000, 18168000,
+  21000000, 21450000, 24890000, 24990000, 28000000, 29700000
+};
+
+static const char * const band_label[] = { "80M", "60M", "40M", "30M", "20M", "17M", "15M", "12M", "10M" };
+
+#endif
@@ -0,0 +1,125 @@
+
+// ============================================================================
+//
+// dac_snr.cpp   - in-band SNR of the PWM DAC output
+//
+// usage: dac_snr [-t hz] [-b hz] [-n log2]
+//
+//   -t hz       test tone (default 1000, scaled to the audio rate)
+//   -b hz       top of the audio band (default 3000, scaled)
+//   -n log2     FFT length, log2 (default 16)
+//
+// For every dacmode and a range of levels a sine is fed to dac_upsample()
+// at the audio rate, followed by DSP_DECIM load_dac_audio() calls as
+// sample_dsp() makes them, and the 8-bit PWM duty values are collected.
+// A Blackman-Harris windowed FFT of the duty sequence gives the tone
+// power and the noise (plus distortion) power from 300 Hz to the top of
+// the audio band, and the noise power above the band.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <complex>
+#include <vector>
+#include "hal_host.h"
+#include "recv.h"
+
+#define DAC_RATE    (ADC_RATE / 2.0)           // duty updates per second
+#define AUDIO_FS    (DAC_RATE / DSP_DECIM)     // dac_upsample() rate
+
+typedef std::complex<double> cplx;
+
+extern uint8_t dacmode;
+
+RECV recv;
+
+static std::vector<double> duty;
+
+static void dac_sink(uint8_t val) {
+  duty.push_back(val);
+}
+
+// in-place radix-2 FFT
+static void fft(std::vector<cplx> &x) {
+  size_t n = x.size();
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t b = n >> 1;
+    for (; j & b; b >>= 1) j ^= b;
+    j ^= b;
+    if (i < j) std::swap(x[i], x[j]);
+  }
+  for (size_t len = 2; len <= n; len <<= 1) {
+    cplx w = std::polar(1.0, -2 * M_PI / len);
+    for (size_t i = 0; i < n; i += len) {
+      cplx wk = 1;
+      for (size_t k = 0; k < len / 2; k++) {
+        cplx a = x[i + k], b = x[i + k + len/2] * wk;
+        x[i + k] = a + b;
+        x[i + k + len/2] = a - b;
+        wk *= w;
+      }
+    }
+  }
+}
+
+static void usage() {
+  fprintf(stderr, "usage: dac_snr [-t hz] [-b hz] [-n log2]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  double tone = 1000 * 4 / DSP_DECIM, band = 3000 * 4 / DSP_DECIM;
+  int lg = 16;
+  int ch;
+  while ((ch = getopt(argc, argv, "t:b:n:h")) != -1) {
+    switch (ch) {
+      case 't': tone = atof(optarg); break;
+      case 'b': band = atof(optarg); break;
+      case 'n': lg = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  size_t n = (size_t)1 << lg;
+  hal_dac_sink = dac_sink;
+
+  const char *names[] = { "CIC2    ", "CIC2 NS1", "CIC2 NS2", "CIC3    ", "CIC3 NS1", "CIC3 NS2" };
+  const double levels[] = { 0, -12, -24, -36, -48 };
+  printf("tone %.0f Hz, band 300-%.0f Hz, DAC %.0f Hz, FFT %zu\n", tone, band, DAC_RATE, n);
+  printf("mode       level  SNR in band   noise above band (dBc)\n");
+  for (uint8_t m = DAC_CIC2; m <= DAC_CIC3NS2; m++) {
+    dacmode = m;
+    recv.configure();
+    for (double lv : levels) {
+      double a = 1023 * pow(10, lv / 20);   // ac3 +/-1024: PWM full scale
+      duty.clear();
+      size_t k = 0;
+      while (duty.size() < n + 1024) {
+        recv.dac_upsample(lrint(a * sin(2 * M_PI * tone * k++ / AUDIO_FS)));
+        for (uint8_t d = 0; d < DSP_DECIM; d++) recv.load_dac_audio();
+      }
+      // skip the start-up, window, transform
+      std::vector<cplx> x(n);
+      for (size_t i = 0; i < n; i++) {
+        double p = 2 * M_PI * i / n;
+        double w = 0.35875 - 0.48829 * cos(p) + 0.14128 * cos(2*p) - 0.01168 * cos(3*p);
+        x[i] = w * duty[1024 + i];
+      }
+      fft(x);
+      double hz = DAC_RATE / n;
+      size_t kt = lrint(tone / hz), k0 = lrint(300 / hz), k1 = lrint(band / hz);
+      double ps = 0, pn = 0, ph = 0;
+      for (size_t b = 1; b < n / 2; b++) {
+        double p = std::norm(x[b]);
+        if ((b + 6 >= kt) && (b <= kt + 6)) ps += p;
+        else if ((b >= k0) && (b <= k1)) pn += p;
+        else if (b > k1) ph += p;
+      }
+      printf("%s  %4.0f dB  %6.1f dB     %6.1f dB\n", names[m], lv,
+             10 * log10(ps / pn), 10 * log10(ph / ps));
+    }
+  }
+  return 0;
+}
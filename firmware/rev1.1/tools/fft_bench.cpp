@@ -0,0 +1,155 @@
+
+// ============================================================================
+//
+// fft_bench.cpp   - bandscope FFT check and timing
+//
+// Host build (build/fft_bench):
+//
+//   fft_bench [-t hz] [-l level] [-n frames]
+//
+//   A complex tone is run through the receiver's ADC path, captured
+//   with the bandscope hook and transformed.  Prints the column levels
+//   as the OLED would show them (lowest RF left), the peak bin, the
+//   largest level error against a double precision DFT of the same
+//   capture, and the time per frame.
+//
+// AVR build, run under simavr (make fft-bench):
+//
+//   Cycles for the window step, each stage, the levels and a frame.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef __AVR__
+#include <math.h>
+#include <unistd.h>
+#include <chrono>
+#endif
+#include "fft.h"
+#include "recv.h"
+
+#ifdef __AVR__
+
+#include <Arduino.h>
+#include "sim.h"
+
+static int16_t x[2*FFT_N];
+static uint8_t lvl[FFT_N];
+
+int main() {
+  sim_console();
+  cli();
+  TCCR1A = 0;                 // timer1 normal mode
+  TCCR1B = (1 << CS10);       // no prescaler: counts CPU cycles
+
+  for (uint8_t n = 0; n < 2*FFT_N; n++) x[n] = rnd() >> 2;
+  uint16_t t0 = TCNT1;
+  fft_window(x);
+  uint16_t t1 = TCNT1;
+  uint32_t frame = t1 - t0;      // over 65535: sum in 32 bits
+  printf("fft_window  %5u cycles\n", t1 - t0);
+  for (uint8_t s = 0; s < FFT_LOG2; s++) {
+    t0 = TCNT1;
+    fft_stage(x, s);
+    t1 = TCNT1;
+    frame += t1 - t0;
+    printf("fft_stage %u %5u cycles\n", s, t1 - t0);
+  }
+  t0 = TCNT1;
+  for (uint8_t k = 0; k < FFT_N; k++) lvl[k] = fft_level(x, k);
+  t1 = TCNT1;
+  frame += t1 - t0;
+  printf("fft_level   %5u cycles\n", t1 - t0);
+  printf("frame      %6lu cycles\n", frame);
+
+  sim_exit();
+}
+
+#else
+
+#include "hal_host.h"
+
+#define IQ_RATE  (ADC_RATE / 2)
+
+RECV recv;
+
+static void usage() {
+  fprintf(stderr, "usage: fft_bench [-t hz] [-l level] [-n frames]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int frames = 100000;
+  int ch;
+  while ((ch = getopt(argc, argv, "t:l:n:h")) != -1) {
+    switch (ch) {
+      case 't': hal_tone.hz = atof(optarg); break;
+      case 'l': hal_tone.level = atof(optarg); break;
+      case 'n': frames = atoi(optarg); break;
+      default: usage();
+    }
+  }
+
+  // capture through the receiver
+  static int16_t cap[2*FFT_N], x[2*FFT_N];
+  hal_adc_source = hal_adc_tone;
+  recv.begin();
+  for (int k = 0; k < 8*FFT_N; k++) recv.sample_dsp();  // settle
+  recv.scope_arm(cap);
+  while (!recv.scope_ready()) recv.sample_dsp();
+
+  // fixed point
+  for (int n = 0; n < 2*FFT_N; n++) x[n] = cap[n];
+  fft_run(x);
+
+  // double precision reference, same window and scaling
+  double maxerr = 0;
+  for (int k = 0; k < FFT_N; k++) {
+    double re = 0, im = 0;
+    for (int n = 0; n < FFT_N; n++) {
+      double w = 0.5 - 0.5 * cos(2 * M_PI * n / FFT_N);
+      double ph = -2 * M_PI * k * n / FFT_N;
+      re += w * (cap[2*n] * cos(ph) - cap[2*n+1] * sin(ph));
+      im += w * (cap[2*n] * sin(ph) + cap[2*n+1] * cos(ph));
+    }
+    double mag = sqrt(re*re + im*im) / (2 * FFT_N);
+    if (mag >= 16) {
+      double ref = 16 * log2(mag);
+      double err = fabs(fft_level(x, k) - ref) * 6.02 / 16;
+      if (err > maxerr) maxerr = err;
+    }
+  }
+
+  // column levels, lowest RF left
+  uint8_t pk = 0, pkcol = 0;
+  printf("col  bin  offset   level\n");
+  for (uint8_t c = 0; c < FFT_N; c++) {
+    uint8_t k = fft_col2bin(c);
+    uint8_t l = fft_level(x, k);
+    if (l > pk) {
+      pk = l;
+      pkcol = c;
+    }
+    printf("%3u  %3u  %+6.0f  %3u  %.*s\n", c, k,
+           ((int)c - FFT_N/2) * (double)IQ_RATE / DSP_DECIM / FFT_N, l, l / 4, "################################################################");
+  }
+  printf("peak column %u (%+.0f Hz)\n", pkcol, ((int)pkcol - FFT_N/2) * (double)IQ_RATE / DSP_DECIM / FFT_N);
+  printf("max level error %.2f dB (bins above 24 dB)\n", maxerr);
+
+  // timing
+  typedef std::chrono::steady_clock clk;
+  volatile uint8_t sink = 0;
+  clk::time_point t0 = clk::now();
+  for (int f = 0; f < frames; f++) {
+    for (int n = 0; n < 2*FFT_N; n++) x[n] = cap[n];
+    fft_run(x);
+    for (uint8_t k = 0; k < FFT_N; k++) sink = fft_level(x, k);
+  }
+  double t = std::chrono::duration<double>(clk::now() - t0).count();
+  (void)sink;
+  printf("frame %.2f us (%d frames)\n", 1e6 * t / frames, frames);
+  return 0;
+}
+
+#endif
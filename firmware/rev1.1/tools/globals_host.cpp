@@ -0,0 +1,18 @@
+
+// ============================================================================
+//
+// globals_host.cpp   - radio settings normally owned by hfrx.ino
+//
+// ============================================================================
+
+#include <inttypes.h>
+#include "globals.h"
+
+uint8_t radiomode = USB;      // radio mode
+uint8_t volume    = 10;       // audio volume
+uint8_t filterbw  = BWFULL;   // filter bandwidth
+uint8_t dg_attn   = 4;        // digital attenuation
+uint8_t agc       = OFF;      // auto gain control
+uint8_t iqbal     = OFF;      // I/Q balance mode
+uint8_t dacmode   = DAC_CIC2; // DAC output mode
+uint8_t rxstate   = 0;        // rx state
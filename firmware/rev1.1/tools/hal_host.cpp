@@ -0,0 +1,72 @@
+
+// ============================================================================
+//
+// hal_host.cpp   - host implementation of the receiver hardware layer
+//
+// The ADC is modelled like the ATmega328 one used by RECV::get_adc():
+// each read selects the next input, starts a conversion and returns
+// the result of the previous conversion.
+//
+// ============================================================================
+
+#include <math.h>
+#include "hal_host.h"
+
+uint16_t (*hal_adc_source)(uint8_t pin) = 0;
+void     (*hal_dac_sink)(uint8_t val)   = 0;
+
+uint8_t  hal_dac_pwm_top = 255;
+uint8_t  hal_adc_ocr     = 0;
+bool     hal_dac_enabled = false;
+
+static uint16_t adc_result = 511;
+
+void hal_init_adc() {
+  adc_result = 511;
+}
+
+void hal_init_dac() {
+}
+
+void hal_dac_enable(bool val) {
+  hal_dac_enabled = val;
+}
+
+void hal_dac_top(uint8_t top) {
+  hal_dac_pwm_top = top;
+}
+
+void hal_adc_timer(uint8_t ocr) {
+  hal_adc_ocr = ocr;
+}
+
+uint16_t hal_adc_read(uint8_t adcpin) {
+  uint16_t prev = adc_result;
+  adc_result = hal_adc_source ? hal_adc_source(adcpin) : 511;
+  return prev;
+}
+
+void hal_dac_write(uint8_t val) {
+  if (hal_dac_sink) hal_dac_sink(val);
+}
+
+uint16_t hal_adc10(int16_t s) {
+  int16_t v = (s >> 6) + 512;
+  return min(max(v, 0), 1023);
+}
+
+hal_tone_t hal_tone = { -1000, 8000, 0, 0, 0 };
+
+uint16_t hal_adc_tone(uint8_t pin) {
+  double ph = 2 * M_PI * hal_tone.hz * hal_tone.pos / (ADC_RATE / 2);
+  double s;
+  if (pin == QSDI) {
+    s = hal_tone.level * cos(ph);
+  } else {
+    // converted one tick after the QSDI input
+    ph += M_PI * hal_tone.hz / (ADC_RATE / 2);
+    s = hal_tone.level * pow(10, hal_tone.gain / 20) * sin(ph + hal_tone.phase * M_PI / 180);
+    hal_tone.pos++;
+  }
+  return hal_adc10(s);
+}
@@ -0,0 +1,43 @@
+
+// ============================================================================
+//
+// hal_host.h   - hooks into the host hardware layer
+//
+// ============================================================================
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <Arduino.h>
+#include "hal.h"
+
+// called for every ADC conversion, returns a 10-bit sample
+extern uint16_t (*hal_adc_source)(uint8_t pin);
+
+// called for every PWM DAC load
+extern void (*hal_dac_sink)(uint8_t val);
+
+extern uint8_t hal_dac_pwm_top;   // PWM TOP value (ICR1)
+extern uint8_t hal_adc_ocr;       // sample clock compare value (OCR2A)
+extern bool    hal_dac_enabled;   // speaker output enable
+
+// ADC models for the tools
+
+// 16-bit signed sample to the unsigned 10-bit conversion
+uint16_t hal_adc10(int16_t s);
+
+// complex tone: I = cos, Q = sin with a Q gain and phase error
+struct hal_tone_t {
+  double hz;      // at the I/Q pair rate, ADC_RATE/2
+  double level;   // peak, 16-bit scale
+  double gain;    // Q gain error (dB)
+  double phase;   // Q phase error (deg)
+  size_t pos;     // I/Q pairs so far
+};
+
+extern hal_tone_t hal_tone;
+
+// hal_adc_source for hal_tone
+uint16_t hal_adc_tone(uint8_t pin);
+
+#endif
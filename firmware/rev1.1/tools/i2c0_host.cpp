@@ -0,0 +1,47 @@
+
+// ============================================================================
+//
+// i2c0_host.cpp   - host I2C0 bus, SI5351 writes go to the register model
+//
+// Transactions addressed to SI5351_ADDR are applied to si5351_model,
+// anything else is dropped.  Reads return the model's register.
+//
+// ============================================================================
+
+#include "i2c0.h"
+#include "si5351.h"
+#include "si5351_model.h"
+
+I2C0 i2c0;    // owned by hfrx.ino on the radio
+
+I2C0::I2C0() {
+}
+
+void I2C0::begin() {
+}
+
+void I2C0::end() {
+}
+
+void I2C0::write(uint8_t addr, uint8_t reg, uint8_t data) {
+  if (addr == SI5351_ADDR) si5351_model.write(reg, &data, 1);
+}
+
+void I2C0::write(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t n) {
+  if (addr == SI5351_ADDR) si5351_model.write(reg, data, n);
+}
+
+void I2C0::writezeros(uint8_t addr, uint8_t reg, uint8_t n) {
+  uint8_t z[256] = { 0 };
+  if (addr == SI5351_ADDR) si5351_model.write(reg, z, n);
+}
+
+void I2C0::writeones(uint8_t addr, uint8_t reg, uint8_t n) {
+  uint8_t o[256];
+  memset(o, 0xff, sizeof(o));
+  if (addr == SI5351_ADDR) si5351_model.write(reg, o, n);
+}
+
+uint8_t I2C0::read(uint8_t addr, uint8_t reg) {
+  return (addr == SI5351_ADDR) ? si5351_model.reg[reg] : 0xff;
+}
@@ -0,0 +1,32 @@
+
+// ============================================================================
+//
+// Arduino.h   - minimal host stand-in for the Arduino core
+//
+// Only what the DSP sources need to compile as a plain Linux library.
+//
+// ============================================================================
+
+#ifndef ARDUINO_H_HOST
+#define ARDUINO_H_HOST
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef F_CPU
+#define F_CPU   20000000UL
+#endif
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+#define PROGMEM
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+#define noInterrupts()
+#define interrupts()
+
+#endif
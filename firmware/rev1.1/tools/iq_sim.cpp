@@ -0,0 +1,106 @@
+
+// ============================================================================
+//
+// iq_sim.cpp   - opposite sideband rejection with I/Q imbalance
+//
+// usage: iq_sim [-G db] [-P deg] [-t hz] [-l level] [-s secs]
+//
+//   -G db       gain imbalance, Q relative to I (default 1.0)
+//   -P deg      phase imbalance of Q (default 3.0)
+//   -t hz       wanted tone, the image is at -hz (default -1000, USB)
+//   -l level    tone peak level (default 8000)
+//   -s secs     length of each run (default 3)
+//
+// The wanted tone and its image are each run through the receiver
+// with iqbal OFF and with iqbal AUTO (starting from zero correction,
+// iq_adapt() polled as the main loop would).  The output level over
+// the last third of each run gives the sideband rejection in dB.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "hal_host.h"
+#include "recv.h"
+
+#define IQ_RATE  (ADC_RATE / 2)
+
+extern uint8_t iqbal;
+
+RECV recv;
+
+static double tone = -1000;
+static double acc, acc2;      // output sums
+static size_t nacc, nskip;
+
+static void dac_sink(uint8_t val) {
+  if (nskip) {
+    nskip--;
+    return;
+  }
+  acc += val;
+  acc2 += (double)val * val;
+  nacc++;
+}
+
+// run one tone, return the output RMS
+static double run(double f, uint8_t mode, double secs) {
+  size_t ticks = 2 * (size_t)(secs * IQ_RATE);
+  hal_tone.hz = f;
+  hal_tone.pos = 0;
+  acc = acc2 = 0;
+  nacc = 0;
+  nskip = ticks / 2 * 2 / 3;
+  iqbal = mode;
+  recv.iq_set(0, 0);
+  recv.begin();
+  for (size_t k = 0; k < ticks; k++) {
+    recv.sample_dsp();
+    if ((mode == IQ_AUTO) && !(k & 63)) recv.iq_adapt();
+  }
+  double m = acc / nacc;
+  return sqrt(acc2 / nacc - m * m);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: iq_sim [-G db] [-P deg] [-t hz] [-l level] [-s secs]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  double secs = 3;
+  hal_tone.gain = 1.0;    // Q imbalance
+  hal_tone.phase = 3.0;
+  int ch;
+  while ((ch = getopt(argc, argv, "G:P:t:l:s:h")) != -1) {
+    switch (ch) {
+      case 'G': hal_tone.gain = atof(optarg); break;
+      case 'P': hal_tone.phase = atof(optarg); break;
+      case 't': tone = atof(optarg); break;
+      case 'l': hal_tone.level = atof(optarg); break;
+      case 's': secs = atof(optarg); break;
+      default: usage();
+    }
+  }
+  hal_adc_source = hal_adc_tone;
+  hal_dac_sink = dac_sink;
+
+  printf("imbalance %.2f dB %.2f deg, tone %.0f Hz\n", hal_tone.gain, hal_tone.phase, tone);
+  const uint8_t modes[] = { OFF, IQ_AUTO };
+  const char *names[] = { "OFF ", "AUTO" };
+  for (int m = 0; m < 2; m++) {
+    double w = run(tone, modes[m], secs);
+    int16_t p, g;
+    recv.iq_get(&p, &g);
+    double i = run(-tone, modes[m], secs);
+    printf("iqbal %s  wanted %7.2f  image %7.2f  rejection %5.1f dB", names[m], w, i,
+           20 * log10(w / max(i, 1e-3)));
+    if (modes[m] == IQ_AUTO) {
+      printf("  (g %+.4f p %+.4f)", g / 65536.0, p / 65536.0);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,199 @@
+
+// ============================================================================
+//
+// isr_bench.cpp   - cycle budget of the TIMER2_COMPA sample clock ISR
+//
+// AVR program, run under simavr:
+//
+//   make isr-bench [BUDGET=320]
+//
+// For every filterbw / radiomode / agc combination (with the AGC cost
+// per mode against agc=OFF), then for every
+// dacmode and for I/Q balance off and on, the receiver's sample_dsp() is called for ROUNDS full rounds
+// of 2*DSP_DECIM phases.  The ADC delivers a 977 Hz tone at 384 LSB
+// peak plus LFSR noise (built with HAL_ADC_SIM, hal.h), so the AGC, I/Q
+// balance and filters work on a signal rather than a constant
+// conversion.  The DAC output runs in the odd (Q) phases.  Timer1 runs
+// at the CPU clock, so TCNT1 deltas are exact cycle counts.  Results
+// are printed on the simavr console as min/avg/max per rxstate phase.
+// A phase whose max exceeds BUDGET prints an OVER line, which makes
+// the make target fail.  So does a run that ends before the final
+// PASS line (simavr crash, bad build): the tee hides simavr's status.
+//
+// The default budget is the cycles between ADC_RATE ticks (320 at
+// 62.5 kHz and 20 MHz), less the ~30 cycles of ISR entry/exit not
+// measured here.
+//
+// Built with DEFS=-DISR_PROF=1 each call is wrapped in PROF_ENTER() and
+// PROF_EXIT() as in the ISR, and the cost of the pair is printed first.
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include "sim.h"
+#include "recv.h"
+#include "prof.h"
+
+#ifndef BUDGET
+#define BUDGET  (F_CPU / ADC_RATE - 30)
+#endif
+
+#define ROUNDS  64
+
+extern uint8_t radiomode, volume, filterbw, dg_attn, agc, dacmode, iqbal, rxstate;
+
+RECV recv;
+
+const char *mode_name[] = { "USB", "LSB" };
+const char *agc_name[]  = { "OFF", "FAST", "SLOW", "LOOK" };
+const char *dac_name[]  = { "CIC2", "CIC2 NS1", "CIC2 NS2", "CIC3", "CIC3 NS1", "CIC3 NS2" };
+const char *iq_name[]   = { "OFF", "AUTO" };
+
+#define PHASES  (2*DSP_DECIM)
+
+// ADC stimulus: one tone cycle per 32 I/Q pairs
+static const int16_t tone_tab[32] = {
+  0, 75, 147, 213, 272, 319, 355, 377, 384, 377, 355, 319, 272, 213, 147, 75,
+  0, -75, -147, -213, -272, -319, -355, -377, -384, -377, -355, -319, -272, -213, -147, -75
+};
+static uint8_t tone_ph;
+
+volatile uint16_t hal_adc_sim;
+
+// the conversion read at rxstate s: I (cos) on even, Q (sin) on odd
+// phases, with +/-16 LSB of noise
+static uint16_t stimulus(uint8_t s) {
+  int16_t v;
+  if (s & 1) {
+    v = tone_tab[tone_ph];
+    tone_ph = (tone_ph + 1) & 31;
+  } else {
+    v = tone_tab[(tone_ph + 8) & 31];
+  }
+  return 511 + v + (rnd() >> 11);
+}
+
+uint16_t cmin[PHASES], cmax[PHASES];
+uint32_t csum[PHASES];
+uint8_t  over = 0;
+
+// measurement overhead of the TCNT1 reads
+static uint16_t overhead() {
+  uint16_t t0 = TCNT1;
+  asm volatile("");
+  uint16_t t1 = TCNT1;
+  return t1 - t0;
+}
+
+// time ROUNDS x PHASES calls of sample_dsp()
+static void run(uint16_t ovh) {
+  for (uint8_t p = 0; p < PHASES; p++) {
+    cmin[p] = 0xffff;
+    cmax[p] = 0;
+    csum[p] = 0;
+  }
+  rxstate = 0;
+  for (uint16_t n = 0; n < ROUNDS * PHASES; n++) {
+    uint8_t p = rxstate;
+    hal_adc_sim = stimulus(p);
+    uint16_t t0 = TCNT1;
+    {
+      PROF_ENTER(p);
+      recv.sample_dsp();
+      PROF_EXIT();
+    }
+    uint16_t t1 = TCNT1;
+    uint16_t c = t1 - t0 - ovh;
+    if (c < cmin[p]) cmin[p] = c;
+    if (c > cmax[p]) cmax[p] = c;
+    csum[p] += c;
+  }
+}
+
+#if ISR_PROF
+// cycles the profiler adds to the sample clock ISR: PROF_ENTER() and
+// PROF_EXIT() with nothing between them (timer2 stopped, so no overrun)
+static uint16_t prof_cost(uint16_t ovh) {
+  prof_clear();
+  cli();
+  uint16_t t0 = TCNT1;
+  {
+    PROF_ENTER(0);
+    PROF_EXIT();
+  }
+  uint16_t t1 = TCNT1;
+  return t1 - t0 - ovh;
+}
+#endif
+
+// longest phase of the last run
+static uint16_t worst() {
+  uint16_t w = 0;
+  for (uint8_t p = 0; p < PHASES; p++) w = max(w, cmax[p]);
+  return w;
+}
+
+// print the phases, flag those over budget
+static void report() {
+  for (uint8_t p = 0; p < PHASES; p++) {
+    printf("  phase %u  min %4u  avg %4lu  max %4u\n",
+           p, cmin[p], csum[p] / ROUNDS, cmax[p]);
+    if (cmax[p] > BUDGET) {
+      printf("OVER phase %u max %u > %u\n", p, cmax[p], (uint16_t)BUDGET);
+      over = 1;
+    }
+  }
+}
+
+int main() {
+  sim_console();
+  cli();
+  recv.init_adc();
+  TCCR1A = 0;                 // timer1 normal mode
+  TCCR1B = (1 << CS10);       // no prescaler: counts CPU cycles
+  uint16_t ovh = overhead();
+
+  printf("sample_dsp() cycles, budget %u per tick\n", (uint16_t)BUDGET);
+#if ISR_PROF
+  printf("ISR_PROF: PROF_ENTER/PROF_EXIT add %u cycles, included below\n", prof_cost(ovh));
+#endif
+  for (uint8_t bw = BW1500; bw <= BWCW300; bw++) {
+    for (uint8_t m = USB; m <= LSB; m++) {
+      uint16_t w_off = 0;
+      for (uint8_t a = OFF; a <= LOOK; a++) {
+        filterbw = bw;
+        radiomode = m;
+        agc = a;
+        recv.configure();
+        run(ovh);
+        printf("filterbw=%u radiomode=%s agc=%s\n", bw, mode_name[m], agc_name[a]);
+        report();
+        // the AGC runs in the process() phase: its cost is the longest
+        // phase against agc=OFF
+        if (a == OFF) w_off = worst();
+        else printf("  agc %s: longest phase %+d cycles over OFF\n", agc_name[a], worst() - w_off);
+      }
+    }
+  }
+  filterbw = BWFULL;
+  radiomode = USB;
+  agc = OFF;
+  for (uint8_t d = DAC_CIC2; d <= DAC_CIC3NS2; d++) {
+    dacmode = d;
+    recv.configure();
+    run(ovh);
+    printf("dacmode=%s\n", dac_name[d]);
+    report();
+  }
+  dacmode = DAC_CIC2;
+  for (uint8_t q = OFF; q <= IQ_AUTO; q++) {
+    iqbal = q;
+    recv.configure();
+    run(ovh);
+    printf("iqbal=%s\n", iq_name[q]);
+    report();
+  }
+  printf(over ? "FAIL\n" : "PASS\n");
+
+  sim_exit();
+}
@@ -0,0 +1,103 @@
+
+// ============================================================================
+//
+// mac_bench.cpp   - AVR multiply-accumulate FIR kernel check and timing
+//
+// AVR program, run under simavr:
+//
+//   make mac-bench
+//
+// For the CW filter coefficient sets and a full-scale coefficient set
+// the inline-asm fir_mac() is run against the C reference fir_mac_ref()
+// on pseudo-random full-range input and on a synthesized tone, and the
+// CW sets also against the shift-add FIR<> kernel (input kept within the
+// +/-16383 FIRMac range).  Any difference prints a DIFF line, which makes
+// the make target fail.  Cycle counts per call come from Timer1.
+//
+// ============================================================================
+
+#include <Arduino.h>
+#include "sim.h"
+#include "fir.h"
+
+#define NTEST  256
+
+typedef FIR<28, -1, -75, -196, -317, -359, -255, 2, 336, 620, 731> csd21;
+typedef FIRMac<28, -1, -75, -196, -317, -359, -255, 2, 336, 620, 731> mac21;
+typedef FIR<0, 23, 57, 91, 107, 80, -2, -127, -258, -343, -333, -211, 1, 240, 427, 498> csd31;
+typedef FIRMac<0, 23, 57, 91, 107, 80, -2, -127, -258, -343, -333, -211, 1, 240, 427, 498> mac31;
+typedef FIRMac<-32768, 32767, -1, 1, -32768, 32767, 255, -256, 0, 32767, -32768> edge21;
+
+typedef int16_t (*fir_t)(const int16_t *, uint8_t);
+
+static int16_t x[64];     // mirrored test delay line
+static uint8_t diffs = 0;
+
+// fill the delay line: random (scaled by >> shift) or a tone
+static void fill(uint8_t tone, uint8_t shift, uint16_t n) {
+  for (uint8_t k = 0; k < 32; k++) {
+    int16_t v;
+    if (tone) {
+      // coarse triangle tone, period 24 samples
+      int8_t p = (n + k) % 24;
+      v = (p < 12) ? (p - 6) * 2700 : (18 - p) * 2700;
+      v >>= shift;
+    } else {
+      v = rnd() >> shift;
+    }
+    x[k] = x[k+32] = v;
+  }
+}
+
+// time one kernel call in cycles
+static uint16_t timed(fir_t f, int16_t &y) {
+  uint16_t t0 = TCNT1;
+  y = f(x, 10);
+  uint16_t t1 = TCNT1;
+  return t1 - t0;
+}
+
+static void check(const char *name, const int16_t *coef, uint8_t m,
+                  fir_t mac, fir_t csd, uint8_t shift) {
+  uint32_t cyc_mac = 0, cyc_csd = 0, cyc_ref = 0;
+  for (uint16_t n = 0; n < NTEST; n++) {
+    fill(n & 1, shift, n);
+    int16_t ym, yc, yr;
+    cyc_mac += timed(mac, ym);
+    uint16_t t0 = TCNT1;
+    yr = fir_mac_ref(x, coef, m, 10);
+    uint16_t t1 = TCNT1;
+    cyc_ref += t1 - t0;
+    if (ym != yr) {
+      printf("DIFF %s n=%u mac %d ref %d\n", name, n, ym, yr);
+      diffs = 1;
+    }
+    if (csd) {
+      cyc_csd += timed(csd, yc);
+      if (ym != yc) {
+        printf("DIFF %s n=%u mac %d csd %d\n", name, n, ym, yc);
+        diffs = 1;
+      }
+    }
+  }
+  printf("%-8s %2u taps  mac %5lu  ref %5lu", name, 2*m+1, cyc_mac / NTEST, cyc_ref / NTEST);
+  if (csd) printf("  csd %5lu", cyc_csd / NTEST);
+  printf(" cycles\n");
+}
+
+int main() {
+  sim_console();
+  cli();
+  TCCR1A = 0;                 // timer1 normal mode
+  TCCR1B = (1 << CS10);       // no prescaler: counts CPU cycles
+
+  printf("FIR kernel cycles per call (incl. call overhead)\n");
+  check("cw500", mac21::coef, mac21::M, mac21::run, csd21::run, 1);
+  check("cw300", mac31::coef, mac31::M, mac31::run, csd31::run, 1);
+  check("cw500", mac21::coef, mac21::M, mac21::run, NULL, 0);
+  check("cw300", mac31::coef, mac31::M, mac31::run, NULL, 0);
+  check("edge", edge21::coef, edge21::M, edge21::run, NULL, 0);
+  printf(diffs ? "FAIL\n" : "PASS\n");
+
+  sim_exit();
+}
@@ -0,0 +1,235 @@
+// ============================================================================
+//
+// mac_check.cpp   - host check of the mac16() inline asm in fir.h
+//
+//   make mac-check     (needs llvm-mc with the AVR target)
+//
+//   mac_check file.bin acc z a b [file.bin acc z a b ...]
+//
+// The make target takes the asm template of mac16() from fir.h and
+// assembles it for the ATmega328P with llvm-mc, once for each operand
+// binding in MAC_BIND: the first register of acc, then z, a and b.
+// One binding puts the "r" operands low and a, b at the top of the "a"
+// class (r16..r23), the other the reverse.  llvm-mc rejects a register
+// an instruction does not take (mulsu only takes r16..r23).
+//
+// Each binary is run on an emulator of the instructions it uses:
+//
+//   - acc + a*b, over edge operands and 2^20 random ones, against the
+//     32-bit C product
+//   - only acc, z, r0 and r1 may change, and r1 must be 0 again
+//   - fir_mac() with this mac16() against fir_mac_ref() for the CW
+//     filters and a full-scale coefficient set, on random full-range
+//     and tone input, as mac_bench does under simavr
+//
+// Any difference prints a FAIL line and exits with status 1.  The
+// cycles per mac16() are counted from the instructions.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "fir.h"
+#include "filters.h"
+
+typedef FIRMac<-32768, 32767, -1, 1, -32768, 32767, 255, -256, 0, 32767, -32768> edge21;
+
+static int fails;
+
+// the emulated part of the AVR core
+struct avr_t {
+  uint8_t r[32];
+  bool c;              // carry flag
+  uint32_t cycles;
+};
+
+static std::vector<uint16_t> code;
+static uint8_t r_acc, r_z, r_a, r_b;  // operand registers
+static uint32_t mac_cycles;
+
+// run the code once; false on an instruction the emulator does not know
+static bool run(avr_t &m) {
+  for (uint16_t op : code) {
+    uint8_t d = (op >> 4) & 31;
+    uint8_t s = (op & 15) | ((op >> 5) & 16);
+    uint16_t v;
+    switch (op & 0xfc00) {
+      case 0x0c00:   // add
+        v = m.r[d] + m.r[s];
+        m.r[d] = v;
+        m.c = v > 255;
+        m.cycles++;
+        continue;
+      case 0x1c00:   // adc
+        v = m.r[d] + m.r[s] + m.c;
+        m.r[d] = v;
+        m.c = v > 255;
+        m.cycles++;
+        continue;
+      case 0x0800:   // sbc
+        v = m.r[d] - m.r[s] - m.c;
+        m.c = m.r[d] < m.r[s] + m.c;
+        m.r[d] = v;
+        m.cycles++;
+        continue;
+      case 0x2400:   // eor (clr)
+        m.r[d] ^= m.r[s];
+        m.cycles++;
+        continue;
+      case 0x9c00:   // mul: unsigned x unsigned
+        v = m.r[d] * m.r[s];
+        break;
+      default:
+        if ((op & 0xff00) == 0x0200) {          // muls: signed x signed
+          v = (int8_t)m.r[16 + ((op >> 4) & 15)] * (int8_t)m.r[16 + (op & 15)];
+        } else if ((op & 0xff88) == 0x0300) {   // mulsu: signed x unsigned
+          v = (int8_t)m.r[16 + ((op >> 4) & 7)] * m.r[16 + (op & 7)];
+        } else {
+          printf("  FAIL unknown instruction %04x\n", op);
+          return false;
+        }
+    }
+    m.r[0] = v;
+    m.r[1] = v >> 8;
+    m.c = v >> 15;
+    m.cycles += 2;
+  }
+  return true;
+}
+
+// acc + a*b through the emulated mac16(), registers checked
+static int32_t mac16_avr(int32_t acc, int16_t a, int16_t b) {
+  static std::mt19937 rng(7);
+  avr_t m;
+  for (int k = 0; k < 32; k++) m.r[k] = rng();
+  m.r[1] = 0;          // the zero register
+  m.c = rng() & 1;
+  m.cycles = 0;
+  for (int k = 0; k < 4; k++) m.r[r_acc + k] = (uint32_t)acc >> (8 * k);
+  m.r[r_a] = a;
+  m.r[r_a + 1] = (uint16_t)a >> 8;
+  m.r[r_b] = b;
+  m.r[r_b + 1] = (uint16_t)b >> 8;
+  avr_t in = m;
+  if (!run(m)) exit(1);
+  mac_cycles = m.cycles;
+  for (int k = 0; k < 32; k++) {
+    bool out = (k == 0) || (k == 1) || (k == r_z) || ((k >= r_acc) && (k < r_acc + 4));
+    if (!out && (m.r[k] != in.r[k])) {
+      printf("  FAIL r%d changed (a %d, b %d)\n", k, a, b);
+      fails++;
+    }
+  }
+  if (m.r[1]) {
+    printf("  FAIL r1 not restored (a %d, b %d)\n", a, b);
+    fails++;
+  }
+  uint32_t y = 0;
+  for (int k = 0; k < 4; k++) y |= (uint32_t)m.r[r_acc + k] << (8 * k);
+  return y;
+}
+
+// fir_mac() of fir.h with the emulated mac16()
+static int16_t fir_mac_avr(const int16_t *x, const int16_t *c, uint8_t m, uint8_t gain) {
+  const int16_t *xr = x + 2*m;
+  int32_t y = 0;
+  for (uint8_t k = 0; k < m; k++) {
+    int16_t t = (uint16_t)*x++ + (uint16_t)*xr--;  // fold the tap pair
+    y = mac16_avr(y, t, pgm_read_word(c++));
+  }
+  y = mac16_avr(y, *x, pgm_read_word(c));
+  return y >> gain;
+}
+
+// products over edge and random operands
+static void check_mac() {
+  static const int16_t edge[] = { -32768, -32767, -256, -255, -129, -128, -1, 0, 1,
+                                  127, 128, 255, 256, 32767 };
+  static const int32_t acc0[] = { 0, -1, 0x7fffffff, (int32_t)0x80000000, 0x00ffff00, 0x12345678 };
+  uint32_t n = 0, bad = 0;
+  for (int16_t a : edge) {
+    for (int16_t b : edge) {
+      for (int32_t acc : acc0) {
+        n++;
+        if ((uint32_t)mac16_avr(acc, a, b) != (uint32_t)acc + (uint32_t)((int32_t)a * b)) bad++;
+      }
+    }
+  }
+  std::mt19937 rng(1);
+  for (int k = 0; k < (1 << 20); k++) {
+    int32_t acc = rng();
+    int16_t a = rng(), b = rng();
+    n++;
+    if ((uint32_t)mac16_avr(acc, a, b) != (uint32_t)acc + (uint32_t)((int32_t)a * b)) bad++;
+  }
+  printf("  mac16   %7u products, %u differ, %u cycles\n", n, bad, mac_cycles);
+  if (bad) fails++;
+}
+
+// fir_mac() against fir_mac_ref(), as mac_bench
+static void check_fir(const char *name, const int16_t *coef, uint8_t m, uint8_t shift) {
+  static std::mt19937 rng(3);
+  int16_t x[64];
+  uint32_t bad = 0;
+  for (uint16_t n = 0; n < 4096; n++) {
+    for (uint8_t k = 0; k < 32; k++) {
+      int16_t v;
+      if (n & 1) {
+        // coarse triangle tone, period 24 samples
+        int8_t p = (n + k) % 24;
+        v = (p < 12) ? (p - 6) * 2700 : (18 - p) * 2700;
+        v >>= shift;
+      } else {
+        v = (int16_t)rng() >> shift;
+      }
+      x[k] = x[k+32] = v;
+    }
+    int16_t ya = fir_mac_avr(x, coef, m, 10);
+    int16_t yr = fir_mac_ref(x, coef, m, 10);
+    if (ya != yr) {
+      if (bad < 10) printf("  FAIL %s n=%u mac %d ref %d\n", name, n, ya, yr);
+      bad++;
+    }
+  }
+  printf("  %-7s %2u taps, input >> %u: %u of 4096 differ\n", name, 2*m+1, shift, bad);
+  if (bad) fails++;
+}
+
+static bool load(const char *file) {
+  FILE *f = fopen(file, "rb");
+  if (!f) {
+    perror(file);
+    return false;
+  }
+  code.clear();
+  uint8_t w[2];
+  while (fread(w, 1, 2, f) == 2) code.push_back(w[0] | (w[1] << 8));
+  fclose(f);
+  return !code.empty();
+}
+
+int main(int argc, char **argv) {
+  if ((argc < 6) || ((argc - 1) % 5)) {
+    fprintf(stderr, "usage: mac_check file.bin acc z a b [file.bin acc z a b ...]\n");
+    return 1;
+  }
+  for (int k = 1; k < argc; k += 5) {
+    if (!load(argv[k])) return 1;
+    r_acc = atoi(argv[k+1]);
+    r_z = atoi(argv[k+2]);
+    r_a = atoi(argv[k+3]);
+    r_b = atoi(argv[k+4]);
+    printf("%s: acc r%u..r%u, z r%u, a r%u:r%u, b r%u:r%u, %u instructions\n", argv[k],
+           r_acc, r_acc + 3, r_z, r_a + 1, r_a, r_b + 1, r_b, (unsigned)code.size());
+    check_mac();
+    check_fir("cw500", fircw500::coef, fircw500::M, 1);
+    check_fir("cw300", fircw300::coef, fircw300::M, 1);
+    check_fir("cw500", fircw500::coef, fircw500::M, 0);
+    check_fir("cw300", fircw300::coef, fircw300::M, 0);
+    check_fir("edge", edge21::coef, edge21::M, 0);
+  }
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,320 @@
+
+// ============================================================================
+//
+// multi_rx.cpp   - run one RECV chain per channel of a wideband recording
+//
+// usage: multi_rx [options] in.wav freq[:usb|:lsb] ...
+//
+//   in.wav      16-bit stereo I/Q recording (I=left, Q=right), any rate
+//   freq        dial frequency of a channel (Hz), one receiver each;
+//               :lsb selects the sideband for that channel
+//   -c hz       centre frequency of the recording (default 0, the
+//               channel frequencies are then offsets from the centre)
+//   -m mode     default sideband, usb | lsb
+//   -b bw       filter bandwidth index (0=1500 1=2000 2=2500 3=FULL
+//               4=1000 5=CW500 6=CW300)
+//   -a agc      agc mode (0=OFF 1=FAST 2=SLOW 3=LOOK)
+//   -v vol      volume (5..12)
+//   -g attn     digital attenuation index (0..6)
+//   -G dB       gain from the recording to the decimator output, 0 dB
+//               maps full scale to the full scale of the 10-bit ADC
+//   -j n        worker threads (default: all cores)
+//   -S secs     work unit length (default 0.25)
+//   -o prefix   write prefix<freq>.wav per channel (default ch)
+//   -n          no output files (throughput runs)
+//
+// Every channel is mixed down with its own oscillator and resampled to
+// the decimated I/Q rate, the rate RECV::process() runs at in the
+// firmware.  It then goes through its own RECV object.  The recording
+// is split into work units of -S seconds.  Unit k+1 of a channel is
+// only queued when unit k is done, and it goes on the queue of the
+// worker that did unit k.  Idle workers steal units from the other
+// queues.  The receivers run a block at a time on the SIMD kernels
+// (recv_simd.cpp).  The audio is the sample RECV hands to the DAC
+// interpolator, at the audio rate.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "recv.h"
+#include "wav.h"
+
+#define CH_RATE   ((double)ADC_RATE / 2 / DSP_DECIM)   // process() rate
+#define RS_ZEROS  8       // resampler half length (zero crossings)
+#define RS_OS     64      // resampler table steps per input sample
+#define RS_CUT    0.45    // resampler cutoff (of the lower rate)
+
+extern uint8_t radiomode, volume, filterbw, dg_attn, agc;
+
+// windowed sinc resampler prototype, shared by all channels
+static std::vector<float> rs_h;   // h(k/RS_OS), k = 0..half*RS_OS
+static int rs_half;               // half length (input samples)
+
+static void rs_init(double fin) {
+  double fc = RS_CUT * fmin(fin, CH_RATE) / fin;   // cycles per input sample
+  rs_half = ceil(RS_ZEROS / (2 * fc));
+  rs_h.resize(rs_half * RS_OS + 2);
+  for (size_t k = 0; k < rs_h.size(); k++) {
+    double x = (double)k / RS_OS;
+    double s = x ? sin(2 * M_PI * fc * x) / (M_PI * x) : 2 * fc;
+    double w = (x < rs_half) ? 0.42 + 0.5 * cos(M_PI * x / rs_half) + 0.08 * cos(2 * M_PI * x / rs_half) : 0;
+    rs_h[k] = s * w;
+  }
+}
+
+static inline float rs_tap(double x) {
+  x = fabs(x) * RS_OS;
+  size_t k = x;
+  float f = x - k;
+  return rs_h[k] + (rs_h[k+1] - rs_h[k]) * f;
+}
+
+struct Chan {
+  double freq;                  // dial frequency (Hz)
+  uint8_t mode;                 // USB or LSB
+  RECV rx;
+  double w;                     // mixer step (rad per input sample)
+  double t;                     // next output time (input samples)
+  std::vector<float> zi, zq;    // mixed input with rs_half history
+  size_t base;                  // input index of zi[0]
+  std::vector<int16_t> audio;
+};
+
+struct Unit {
+  int ch;                       // channel
+  size_t seg;                   // segment of the recording
+};
+
+struct Worker {
+  std::mutex m;
+  std::deque<Unit> q;
+  size_t units = 0;             // units done
+  size_t steals = 0;            // units taken from other queues
+};
+
+static const int16_t *iq;       // interleaved recording
+static size_t iq_n;             // I/Q samples
+static size_t seg_n;            // I/Q samples per segment
+static size_t nseg;
+static double in_rate;
+static float in_gain;
+static std::vector<Chan *> chans;
+static std::vector<Worker> workers;
+static std::atomic<size_t> pending;
+
+// mix, resample and demodulate one segment of a channel
+static void run_unit(const Unit &u) {
+  Chan &c = *chans[u.ch];
+  size_t k0 = u.seg * seg_n;
+  size_t k1 = min(k0 + seg_n, iq_n);
+  // keep the resampler history, mix the segment
+  size_t keep = min(c.zi.size(), (size_t)2 * rs_half);
+  c.zi.erase(c.zi.begin(), c.zi.end() - keep);
+  c.zq.erase(c.zq.begin(), c.zq.end() - keep);
+  c.base = k0 - keep;
+  // oscillator phasor, exact at the start of each segment
+  double p = fmod(c.w * k0, 2 * M_PI);
+  double co = cos(p), si = sin(p);
+  double dc = cos(c.w), ds = sin(c.w);
+  for (size_t k = k0; k < k1; k++) {
+    float x = iq[2*k], y = iq[2*k+1];
+    c.zi.push_back(x * co + y * si);   // (x + jy) * exp(-jp)
+    c.zq.push_back(y * co - x * si);
+    double t = co * dc - si * ds;
+    si = si * dc + co * ds;
+    co = t;
+  }
+  // resample to CH_RATE and run the receiver
+  std::vector<int16_t> bi, bq;
+  double step = in_rate / CH_RATE;
+  for (; c.t + rs_half < k1; c.t += step) {
+    long m = floor(c.t);
+    float re = 0, im = 0;
+    for (long k = m - rs_half + 1; k <= m + rs_half; k++) {
+      if ((k < (long)c.base) || (k >= (long)k1)) continue;
+      float h = rs_tap(c.t - k);
+      re += c.zi[k - c.base] * h;
+      im += c.zq[k - c.base] * h;
+    }
+    int32_t i = lrintf(re * in_gain);
+    int32_t q = lrintf(im * in_gain);
+    bi.push_back(min(max(i, -32768), 32767));
+    bq.push_back(min(max(q, -32768), 32767));
+  }
+  size_t n = c.audio.size();
+  c.audio.resize(n + bi.size());
+  for (size_t k = 0; k < bi.size(); k += 4096) {
+    c.rx.process_block(&bi[k], &bq[k], &c.audio[n + k], min(bi.size() - k, (size_t)4096));
+  }
+  // +/-2048 to 16 bits
+  for (size_t k = n; k < c.audio.size(); k++) c.audio[k] = min((int32_t)c.audio[k] << 4, 32767);
+}
+
+static bool pop(int id, Unit &u) {
+  Worker &w = workers[id];
+  std::lock_guard<std::mutex> l(w.m);
+  if (w.q.empty()) return false;
+  u = w.q.back();
+  w.q.pop_back();
+  return true;
+}
+
+static bool steal(int id, Unit &u) {
+  int n = workers.size();
+  for (int k = 1; k < n; k++) {
+    Worker &v = workers[(id + k) % n];
+    std::lock_guard<std::mutex> l(v.m);
+    if (v.q.empty()) continue;
+    u = v.q.front();
+    v.q.pop_front();
+    return true;
+  }
+  return false;
+}
+
+static void worker(int id) {
+  Worker &w = workers[id];
+  Unit u;
+  while (pending) {
+    if (!pop(id, u)) {
+      if (!steal(id, u)) {
+        std::this_thread::yield();
+        continue;
+      }
+      w.steals++;
+    }
+    run_unit(u);
+    w.units++;
+    if (++u.seg < nseg) {
+      std::lock_guard<std::mutex> l(w.m);
+      w.q.push_back(u);
+    }
+    pending--;
+  }
+}
+
+typedef std::chrono::steady_clock clk;
+
+static void usage() {
+  fprintf(stderr, "usage: multi_rx [-c hz] [-m usb|lsb] [-b bw] [-a agc] [-v vol] [-g attn] [-G dB]\n"
+                  "                [-j threads] [-S secs] [-o prefix] [-n] in.wav freq[:usb|:lsb] ...\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  double centre = 0;
+  double gain_db = 0;
+  double unit_secs = 0.25;
+  int threads = std::thread::hardware_concurrency();
+  const char *prefix = "ch";
+  bool write = true;
+  uint8_t mode = USB;
+  int ch;
+  while ((ch = getopt(argc, argv, "c:m:b:a:v:g:G:j:S:o:nh")) != -1) {
+    switch (ch) {
+      case 'c': centre = atof(optarg); break;
+      case 'm':
+        if (!strcmp(optarg, "usb")) mode = USB;
+        else if (!strcmp(optarg, "lsb")) mode = LSB;
+        else usage();
+        break;
+      case 'b': filterbw = atoi(optarg); break;
+      case 'a': agc = atoi(optarg); break;
+      case 'v': volume = atoi(optarg); break;
+      case 'g': dg_attn = atoi(optarg); break;
+      case 'G': gain_db = atof(optarg); break;
+      case 'j': threads = atoi(optarg); break;
+      case 'S': unit_secs = atof(optarg); break;
+      case 'o': prefix = optarg; break;
+      case 'n': write = false; break;
+      default: usage();
+    }
+  }
+  if (argc - optind < 2) usage();
+  if (threads < 1) threads = 1;
+
+  WAV in;
+  if (!wav_read(argv[optind], in) || (in.channels != 2) || (in.bits != 16)) {
+    fprintf(stderr, "%s: need a 16-bit stereo I/Q wav file\n", argv[optind]);
+    return 1;
+  }
+  iq = in.data.data();
+  iq_n = in.data.size() / 2;
+  in_rate = in.rate;
+  // 16-bit full scale to the +/-16384 decimator output full scale
+  in_gain = 0.5 * pow(10, gain_db / 20);
+  seg_n = max(1.0, unit_secs * in_rate);
+  nseg = (iq_n + seg_n - 1) / seg_n;
+  rs_init(in_rate);
+
+  for (int k = optind + 1; k < argc; k++) {
+    Chan *c = new Chan;
+    c->freq = atof(argv[k]);
+    c->mode = mode;
+    const char *s = strchr(argv[k], ':');
+    if (s && !strcmp(s, ":usb")) c->mode = USB;
+    else if (s && !strcmp(s, ":lsb")) c->mode = LSB;
+    else if (s) usage();
+    c->w = 2 * M_PI * (c->freq - centre) / in_rate;
+    c->t = 0;
+    c->base = 0;
+    c->audio.reserve(iq_n * CH_RATE / in_rate + 16);
+    radiomode = c->mode;
+    c->rx.configure();
+    chans.push_back(c);
+  }
+
+  // channels are dealt out round robin
+  std::vector<Worker> ws(threads);
+  workers.swap(ws);
+  for (size_t k = 0; k < chans.size(); k++) workers[k % threads].q.push_back({ (int)k, 0 });
+  pending = chans.size() * nseg;
+
+  clk::time_point t0 = clk::now();
+  std::vector<std::thread> pool;
+  for (int k = 0; k < threads; k++) pool.push_back(std::thread(worker, k));
+  for (auto &t : pool) t.join();
+  double el = std::chrono::duration<double>(clk::now() - t0).count();
+
+  double dur = iq_n / in_rate;
+  printf("%zu channels, %.1f s at %.0f Hz, %d threads, %zu units of %.2f s\n",
+         chans.size(), dur, in_rate, threads, nseg * chans.size(), unit_secs);
+  for (int k = 0; k < threads; k++) {
+    printf("  worker %2d   %5zu units  %5zu stolen\n", k, workers[k].units, workers[k].steals);
+  }
+  printf("%.3f s, %.1fx real time, %.1fx per channel\n", el, dur / el, dur * chans.size() / el);
+  printf("%zu B per receiver (RECV), %zu B with its mix buffers\n",
+         sizeof(RECV), sizeof(Chan) + (chans[0]->zi.capacity() + chans[0]->zq.capacity()) * sizeof(float));
+
+  for (Chan *c : chans) {
+    radiomode = c->mode;
+    printf("%12.0f %s  smeter %4d dBFS", c->freq, (c->mode == USB) ? "usb" : "lsb", c->rx.smeter());
+    if (write) {
+      char path[256];
+      snprintf(path, sizeof(path), "%s%.0f.wav", prefix, c->freq);
+      WAV out;
+      out.rate = AUDIO_RATE;
+      out.channels = 1;
+      out.bits = 16;
+      out.data.swap(c->audio);
+      if (!wav_write(path, out)) {
+        fprintf(stderr, "\n%s: cannot write\n", path);
+        return 1;
+      }
+      printf("  %s", path);
+    }
+    printf("\n");
+    delete c;
+  }
+  return 0;
+}
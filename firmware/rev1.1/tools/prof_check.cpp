@@ -0,0 +1,145 @@
+// ============================================================================
+//
+// prof_check.cpp   - host check of the ISR profiler (prof.h, prof.cpp)
+//
+//   make prof-check
+//
+// Builds prof.cpp with ISR_PROF=1 against a model of the timers it
+// reads: TCNT1L counts CPU cycles modulo 256, TCNT2 counts 64 cycles
+// per step and wraps on the sample clock tick, and the compare match
+// flag is set at the tick and cleared on ISR entry.  Every register
+// read takes one cycle, as an AVR "lds".
+//
+// The sample clock ISR is run through PROF_ENTER() and PROF_EXIT() for
+// every entry latency up to 127 cycles, every body length up to the
+// second tick and each TCNT1 phase against the tick.  The cycles the
+// profiler records must equal the model's cycles between the two
+// TCNT1L reads, and the overrun count, histogram bin and entry jitter
+// must match.  Exits on the tick edge check the order of the TCNT2 and
+// flag reads.  Any difference prints a FAIL line and exits with status 1.
+//
+// ============================================================================
+
+#define ISR_PROF  1
+
+#include <stdio.h>
+#include <random>
+#include <Arduino.h>
+#include "globals.h"
+
+// the timers, as functions of the cycle count
+static uint32_t now;          // CPU cycles
+static uint32_t tick_due;     // next compare match
+static uint32_t t1_read;      // cycle of the last TCNT1L read
+
+#define OCF2A   1
+
+static uint8_t rd_tcnt1l() {
+  t1_read = now;
+  return now++ & 255;
+}
+
+static uint8_t rd_tcnt2() {
+  return (now++ % (F_CPU / ADC_RATE)) / 64;
+}
+
+static uint8_t rd_tifr2() {
+  return (now++ >= tick_due) ? (1 << OCF2A) : 0;
+}
+
+#define TCNT1L  rd_tcnt1l()
+#define TCNT2   rd_tcnt2()
+#define TIFR2   rd_tifr2()
+
+// Serial for prof_dump()
+struct Serial_t {
+  void print(const char *s) { fputs(s, stdout); }
+  void print(char c) { putchar(c); }
+  void print(int v) { printf("%d", v); }
+  void print(unsigned long v) { printf("%lu", v); }
+} Serial;
+
+#define F(s)  (s)
+
+#include "../prof.cpp"
+
+static int fails;
+
+// one sample clock ISR: entry e cycles after tick k, body c cycles;
+// returns the model's cycles between the TCNT1L reads
+static uint16_t isr(uint32_t k, uint16_t e, uint16_t c, uint8_t ph) {
+  now = k * PROF_TICK + e;
+  tick_due = (k + 1) * PROF_TICK;
+  PROF_ENTER(ph);
+  uint32_t t0 = t1_read;
+  now += c;
+  PROF_EXIT();
+  return t1_read - t0;
+}
+
+// recorded cycles and overruns against the model
+static void check_cycles() {
+  uint32_t n = 0, bad = 0, late = 0;
+  for (uint32_t k = 0; k < 8; k++) {
+    for (uint16_t e = 0; e < 128; e++) {
+      for (uint16_t c = 0; e + c + 8 < 2 * (uint16_t)PROF_TICK; c++) {
+        prof_clear();
+        uint8_t ph = (k + c) % PROF_PHASES;
+        uint16_t m = isr(k, e, c, ph);
+        uint8_t b = (m < PROF_TICK/2) ? 0 : (m < PROF_TICK*3/4) ? 1 : (m < PROF_TICK) ? 2 : 3;
+        uint16_t ov = (t1_read >= tick_due) ? 1 : 0;
+        n++;
+        late += ov;
+        if ((prof.cmax[ph] != m) || (prof.cmin[ph] != m) || (prof.hist[ph][b] != 1) || (prof.overruns != ov)) {
+          if (bad < 10) {
+            printf("  FAIL tick %u entry +%u body %u: %u cycles, recorded %u, overruns %u of %u\n",
+                   k, e, c, m, prof.cmax[ph], prof.overruns, ov);
+          }
+          bad++;
+        }
+      }
+    }
+  }
+  printf("  cycles   %6u ISRs (%u overruns), %u differ\n", n, late, bad);
+  if (bad) fails++;
+}
+
+// entry to entry jitter over a run of ticks
+static void check_jitter() {
+  std::mt19937 rng(5);
+  uint32_t bad = 0;
+  for (int run = 0; run < 1000; run++) {
+    prof_clear();
+    int jmin = 127, jmax = -128;
+    uint32_t t1e = 0;
+    for (uint32_t k = 0; k < 64; k++) {
+      uint16_t e = 8 + rng() % 100;
+      isr(run * 64 + k, e, 40 + rng() % 150, k % PROF_PHASES);
+      uint32_t te = (run * 64 + k) * PROF_TICK + e;   // entry TCNT1L read
+      if (k) {
+        int j = (int)(te - t1e) - (int)PROF_TICK;
+        if (j < jmin) jmin = j;
+        if (j > jmax) jmax = j;
+      }
+      t1e = te;
+    }
+    if ((prof.jmin != jmin) || (prof.jmax != jmax)) {
+      if (bad < 10) printf("  FAIL jitter run %d: %d/%d, recorded %d/%d\n", run, jmin, jmax, prof.jmin, prof.jmax);
+      bad++;
+    }
+  }
+  printf("  jitter     1000 runs of 64 ticks, %u differ\n", bad);
+  if (bad) fails++;
+}
+
+int main() {
+  printf("ISR profiler, tick %u cycles, %u phases\n", (unsigned)PROF_TICK, PROF_PHASES);
+  check_cycles();
+  check_jitter();
+  // a sample PR report
+  prof_clear();
+  for (uint32_t k = 0; k < 1000; k++) isr(k, 12, 60 + (k % PROF_PHASES) * 30, k % PROF_PHASES);
+  prof_dump();
+  printf("\n");
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,512 @@
+
+// ============================================================================
+//
+// radio_sim.cpp   - whole receiver simulation, antenna to audio
+//
+// usage: radio_sim [options]
+//
+//   -f hz       VFO frequency (default 7074000)
+//   -m mode     usb | lsb (default usb)
+//   -b bw       filter bandwidth index (default 3, FULL)
+//   -a agc      agc mode (0=OFF 1=FAST 2=SLOW 3=LOOK, default 0)
+//   -v vol      volume (5..12, default 10)
+//   -g attn     digital attenuation index (0..6, default 4)
+//   -t hz,dbm   RF tone at hz (absolute), may be repeated
+//               (default: VFO+1000 Hz at -73 dBm)
+//   -r hz,secs  retune the VFO to hz at secs
+//   -s secs     length (default 5)
+//   -o out.wav  write the PWM DAC output (8-bit unsigned, ADC_RATE/2)
+//
+//   -N db       noise figure (default 10)
+//   -R ohm      detector source resistance (default 50)
+//   -C nf       detector sampling capacitors (default 220)
+//   -G db       Q gain imbalance (default 0)
+//   -P deg      Q phase imbalance (default 0)
+//   -A db       baseband gain, detector to ADC (default 40)
+//   -q lsb      ADC input noise, rms (default 0.5)
+//
+//   -M          measure instead of running the tones: MDS, image
+//               rejection and blocking
+//   -B hz       blocker offset for -M (default 20000)
+//   -S lo,step,n[,dwell]
+//               run the band scanner (scan.h) for -s secs instead:
+//               n channels from lo in steps of step Hz, dwell ms
+//               (default 0); prints the levels and the scan rate and
+//               fails on leakage into the channels next to a tone
+//
+// The signal path, one step per sample clock tick:
+//
+//   tones + noise -> Tayloe detector -> 10-bit ADC -> RECV -> PWM DAC
+//                         ^
+//   SI5351::freq_fast() -> register model -> LO frequency, CLK0/CLK1 phase
+//
+// The LO is read back from the register writes of the real SI5351
+// code (si5351_model.h).  The detector works at baseband: each tone is
+// translated by the LO and by its 3rd (opposite sideband, 1/3) and 5th
+// (1/5) harmonics, as the 4-phase switch is a square wave mixer, scaled
+// by the switch conversion gain 2*sqrt(2)/pi and filtered by the single
+// pole of the sampling capacitors, fc = 1/(2*pi*4*R*C).  The noise is
+// kTB plus the noise figure from both sidebands through the same pole.
+// I and Q are sampled on alternate ticks as the ADC multiplexer does;
+// Q carries the gain and phase imbalance plus the LO quadrature error
+// from the CLK0/CLK1 phase offset registers.  The ADC has the 1.1V
+// internal reference, mid-scale bias and input noise.
+//
+// With -S the scanner runs as in the main loop: one scan.step() per
+// pass, at the simulated millisecond time.  The sample clock runs on
+// through each pass for the I2C bus time of the SI5351 writes of that
+// pass (400 kHz) plus LOOP_US for the other main loop tasks; the OLED
+// bar graph is not modelled.  The scan rate is the headline figure:
+// channels per second over the complete sweeps.  A channel next to one
+// with a tone in its passband fails the run when it reads more than
+// ADJ_FLOOR dB over the median and less than ADJ_REJ dB under the tone
+// channel: leakage through the opposite sideband or a short settle.
+// The alias responses of the 31.25 kHz I/Q sampling further out are
+// not checked.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <random>
+#include <vector>
+#include "hal_host.h"
+#include "recv.h"
+#include "si5351.h"
+#include "si5351_model.h"
+#include "scan.h"
+#include "wav.h"
+
+#define IQ_RATE   (ADC_RATE / 2)          // per-channel rate
+#define F_XTAL    27000000UL
+#define ADC_VREF  1.1                     // internal reference (V)
+#define K_DET     (2 * M_SQRT2 / M_PI)    // 4-phase switch conversion gain
+#define I2C_RATE  400000.0                // SI5351 bus (Hz)
+#define LOOP_US   100                     // rest of a main loop pass (us)
+
+typedef std::complex<double> cplx;
+
+extern uint8_t radiomode, volume, filterbw, dg_attn, agc;
+
+RECV recv;
+SI5351 si5351;
+SCAN scan;
+static int8_t scan_lvl[SCAN_N];
+
+// detector and ADC parameters
+static double nf = 10;          // noise figure (dB)
+static double rs = 50;          // source resistance (ohm)
+static double cs = 220e-9;      // sampling capacitors (F)
+static double q_gain = 0;       // Q gain imbalance (dB)
+static double q_phase = 0;      // Q phase imbalance (deg)
+static double bb_gain = 40;     // baseband gain (dB)
+static double adc_noise = 0.5;  // ADC input noise (LSB rms)
+
+// RF tones
+// the detector output of a tone has three terms, from the LO, 3*LO and
+// 5*LO: gain g (detector and pole), phasor z rotating by w per tick
+struct Tone {
+  double hz;                    // frequency (Hz)
+  double dbm;                   // level at the antenna
+  cplx g[3], z[3], w[3];
+};
+
+static std::vector<Tone> tones;
+
+// simulation state
+static double fc;               // detector pole (Hz)
+static double flo;              // LO from the register model (Hz)
+static double lo_err;           // LO quadrature error (rad)
+static uint32_t lo_seq;         // register model state read
+static cplx noise;              // detector noise
+static double n_a, n_b;         // noise pole and innovation
+static double v_lsb;            // ADC input volts per LSB at the detector
+static cplx q_err;              // Q gain and phase error
+static std::mt19937 rng(1);
+static std::normal_distribution<double> gauss;
+static std::vector<uint8_t> dac_out;
+static size_t sim_ticks;        // sample clock ticks run
+
+// dBm into 50 ohm to peak volts
+static double vpeak(double dbm) {
+  return sqrt(100 * pow(10, (dbm - 30) / 10));
+}
+
+// set up the detector from the parameters
+static void detector_init() {
+  fc = 1 / (2 * M_PI * 4 * rs * cs);
+  // both sidebands fold into each channel: 2 * 50 ohm * kTB * F per Hz
+  double n0 = pow(10, (-174 + nf - 30) / 10);
+  double s = K_DET * K_DET * 100 * n0;
+  double var = s * M_PI / 2 * fc;             // one pole noise bandwidth
+  n_a = exp(-2 * M_PI * fc / ADC_RATE);
+  n_b = sqrt(var * (1 - n_a * n_a));
+  v_lsb = ADC_VREF / 1024 / pow(10, bb_gain / 20);
+  q_err = std::polar(pow(10, q_gain / 20), q_phase * M_PI / 180);
+  noise = 0;
+}
+
+// set the tone terms for the current LO
+static void tones_update() {
+  static const int harm[3] = { 1, 3, 5 };
+  for (Tone &t : tones) {
+    double a = K_DET * vpeak(t.dbm);
+    for (int h = 0; h < 3; h++) {
+      double df = t.hz - harm[h] * flo;
+      // 3rd harmonic: opposite rotation; more than 40 dB down: dropped
+      double sgn = (h == 1) ? -1 : 1;
+      t.g[h] = (fabs(df) > 100 * fc) ? 0 : a / harm[h] / cplx(1, df / fc);
+      t.w[h] = std::polar(1.0, sgn * 2 * M_PI * df / ADC_RATE);
+      if (t.z[h] == cplx(0)) t.z[h] = 1;
+    }
+  }
+}
+
+// pick up LO changes from the register model
+static void lo_update() {
+  if (lo_seq == si5351_model.seq) return;
+  lo_seq = si5351_model.seq;
+  flo = si5351_model.fout(0);
+  lo_err = (si5351_model.phase(1) - si5351_model.phase(0) - 90) * M_PI / 180;
+  tones_update();
+}
+
+// detector output at the next tick
+static cplx detector() {
+  static uint16_t n;
+  lo_update();
+  cplx y = 0;
+  for (Tone &t : tones) {
+    for (int h = 0; h < 3; h++) {
+      y += t.g[h] * t.z[h];
+      t.z[h] *= t.w[h];
+      if (!n) t.z[h] /= std::abs(t.z[h]);   // keep the phasors on the unit circle
+    }
+  }
+  n++;
+  noise = n_a * noise + n_b * cplx(gauss(rng), gauss(rng));
+  return y + noise;
+}
+
+// ADC model: I and Q on alternate ticks
+static uint16_t adc_source(uint8_t pin) {
+  cplx z = detector();
+  double v = (pin == QSDI) ? z.imag() : (z * q_err * std::polar(1.0, lo_err)).real();
+  double c = floor(v / v_lsb + adc_noise * gauss(rng) + 512.5);
+  return min(max(c, 0.0), 1023.0);
+}
+
+static void dac_sink(uint8_t val) {
+  dac_out.push_back(val);
+}
+
+// one sample clock tick; block builds process the captured blocks
+// right away, as the main loop does when it keeps up
+static void tick() {
+  recv.sample_dsp();
+#if DSP_MODE == DSP_BLOCK
+  recv.process_blocks();
+#endif
+}
+
+// run for secs
+static void run(double secs) {
+  size_t ticks = 2 * (size_t)(secs * IQ_RATE);
+  for (size_t k = 0; k < ticks; k++) tick();
+  sim_ticks += ticks;
+}
+
+// as update_freq() does: the fast path within +/-5 kHz
+static void tune(int32_t hz) {
+  si5351.freq_fast(hz, 0, 90);
+}
+
+// ----------------------------------------------------------------------------
+// measurements
+// ----------------------------------------------------------------------------
+
+// settle, then collect secs of output
+static void measure(double secs) {
+  tones_update();
+  recv.begin();
+  run(0.25);
+  dac_out.clear();
+  run(secs);
+}
+
+// audio band power: two passes of a DSP_DECIM point moving average
+static double audio_power() {
+  std::vector<double> y(dac_out.begin(), dac_out.end());
+  for (int p = 0; p < 2; p++) {
+    double a = 0;
+    std::vector<double> t(y.size());
+    for (size_t k = 0; k < y.size(); k++) {
+      a += y[k] - ((k >= DSP_DECIM) ? y[k - DSP_DECIM] : 0);
+      t[k] = a / DSP_DECIM;
+    }
+    y.swap(t);
+  }
+  double m = 0, s = 0;
+  for (size_t k = DSP_DECIM; k < y.size(); k++) m += y[k];
+  m /= y.size() - DSP_DECIM;
+  for (size_t k = DSP_DECIM; k < y.size(); k++) s += (y[k] - m) * (y[k] - m);
+  return s / (y.size() - DSP_DECIM);
+}
+
+// output tone power at hz, Hann window
+static double tone_power(double hz) {
+  size_t n = dac_out.size();
+  double re = 0, im = 0, ws = 0;
+  for (size_t k = 0; k < n; k++) {
+    double w = 0.5 - 0.5 * cos(2 * M_PI * k / n);
+    double p = 2 * M_PI * hz * k / IQ_RATE;
+    re += w * dac_out[k] * cos(p);
+    im += w * dac_out[k] * sin(p);
+    ws += w;
+  }
+  double a = 2 * sqrt(re * re + im * im) / ws;
+  return a * a / 2;
+}
+
+static double db(double p) {
+  return 10 * log10(fmax(p, 1e-20));
+}
+
+// MDS, image rejection and blocking
+static void metrics(int32_t vfo, double boff) {
+  double sb = (radiomode == USB) ? 1 : -1;
+  double af = 1000 + sb * (vfo - flo);           // audio tone, LO error included
+  double secs = 1;
+
+  // MDS: tone power equal to the noise power in the audio band
+  tones.clear();
+  measure(secs);
+  double pn = audio_power();
+  double l0 = -90;
+  tones = { { vfo + sb * 1000, l0 } };
+  measure(secs);
+  double ps = tone_power(af);
+  double mds = l0 - db(ps / fmax(pn, 1e-12));
+  printf("MDS          %7.1f dBm   (noise %.2f, tone %.1f at %.0f dBm, PWM units^2)\n",
+         mds, pn, ps, l0);
+
+  // image: the same tone on the other side of the LO
+  double li = -60;
+  tones = { { vfo + sb * 1000, li } };
+  measure(secs);
+  double pw = tone_power(af);
+  tones = { { 2 * flo - (vfo + sb * 1000), li } };
+  measure(secs);
+  double pi = tone_power(af);
+  printf("image        %7.1f dB    (tone %.0f Hz off the LO at %.0f dBm)\n",
+         db(pw / pi), 1000.0, li);
+
+  // blocking: blocker level that drops a tone 20 dB over MDS by 1 dB
+  double lw = mds + 20;
+  tones = { { vfo + sb * 1000, lw } };
+  measure(secs);
+  double p0 = tone_power(af);
+  double lb = -60;
+  for (; lb <= 10; lb += 1) {
+    tones = { { vfo + sb * 1000, lw }, { vfo + sb * boff, lb } };
+    measure(secs);
+    if (db(tone_power(af)) < db(p0) - 1) break;
+  }
+  if (lb > 10) {
+    printf("blocking     > 10 dBm      (blocker %+.0f Hz)\n", sb * boff);
+  } else {
+    printf("blocking     %7.1f dBm   (blocker %+.0f Hz, BDR %.1f dB)\n", lb, sb * boff, lb - mds);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// band scanner
+// ----------------------------------------------------------------------------
+
+#define ADJ_FLOOR  3    // adjacent channel over the median, dB
+#define ADJ_REJ    25   // adjacent channel under the tone channel, dB
+
+// returns the number of failed checks
+static int scan_bench(int32_t lo, int32_t step, int n, int dwell, double secs) {
+  scan.begin(&recv, tune, scan_lvl);
+  scan.start(lo, step, n, dwell);
+  n = scan.n;
+  recv.begin();
+  size_t end = sim_ticks + 2 * (size_t)(secs * IQ_RATE);
+  uint32_t w0 = 0, b0 = 0, r0 = 0, sweeps = 0, ms0 = 0, ms1 = 0;
+  double loop_ticks = LOOP_US * 1e-6 * ADC_RATE, carry = 0;
+  while (sim_ticks < end) {
+    uint32_t w = si5351_model.writes, b = si5351_model.bytes;
+    uint32_t ms = (uint64_t)sim_ticks * 1000 / ADC_RATE;
+    if (scan.step(ms)) {
+      // counters from the end of the first sweep, LO from the start
+      if (!sweeps++) {
+        w0 = si5351_model.writes;
+        b0 = si5351_model.bytes;
+        r0 = si5351_model.pll_resets;
+        ms0 = ms;
+      }
+      ms1 = ms;
+    }
+    lo_update();
+    // the main loop is held on the I2C bus, the sample clock is not
+    uint32_t nw = si5351_model.writes - w, nb = si5351_model.bytes - b;
+    carry += (9 * (nb + 2 * nw) + 2 * nw) / I2C_RATE * ADC_RATE + loop_ticks;
+    size_t t = carry;
+    carry -= t;
+    for (size_t k = 0; k < t; k++) tick();
+    sim_ticks += t;
+  }
+  if (sweeps < 2) {
+    printf("scan: %u sweeps in %.2f s, need 2 or more\n", sweeps, secs);
+    return 1;
+  }
+  uint32_t chans = (sweeps - 1) * n;
+  double el = (ms1 - ms0) / 1000.0;
+  std::vector<int8_t> l(scan.lvl, scan.lvl + n);
+  std::nth_element(l.begin(), l.begin() + n / 2, l.end());
+  int med = l[n / 2];
+  printf("scan %d channels, %d Hz steps from %d Hz, dwell %d ms, %u sweeps\n", n, step, lo, dwell, sweeps);
+  // tones in the passband of each channel
+  std::vector<bool> tch(n);
+  for (int c = 0; c < n; c++) {
+    for (Tone &t : tones) {
+      double a = (radiomode == USB) ? t.hz - scan.freq(c) : scan.freq(c) - t.hz;
+      if ((a > 0) && (a < 3000)) tch[c] = true;
+    }
+    printf("  %9d %4d dB %+4d%s\n", scan.freq(c), scan.lvl[c], scan.lvl[c] - med, tch[c] ? "  <- tone" : "");
+  }
+  int fails = 0;
+  for (int c = 0; c < n; c++) {
+    for (int a = c - 1; a <= c + 1; a += 2) {
+      if (!tch[c] || (a < 0) || (a >= n) || tch[a]) continue;
+      int rej = scan.lvl[c] - scan.lvl[a];
+      if ((scan.lvl[a] - med > ADJ_FLOOR) && (rej < ADJ_REJ)) {
+        printf("  FAIL %d Hz reads %+d dB, %d dB under the tone at %d Hz\n",
+               scan.freq(a), scan.lvl[a] - med, rej, scan.freq(c));
+        fails++;
+      }
+    }
+  }
+  printf("sweep        %.1f ms (%u ms last)\n", 1000 * el / (sweeps - 1), scan.sweep_ms);
+  printf("I2C          %.2f writes, %.2f bytes per channel, %u PLL resets\n",
+         (double)(si5351_model.writes - w0) / chans, (double)(si5351_model.bytes - b0) / chans,
+         si5351_model.pll_resets - r0);
+  printf("scan rate    %.1f channels/s\n", chans / el);
+  return fails;
+}
+
+typedef std::chrono::steady_clock clk;
+
+static void usage() {
+  fprintf(stderr, "usage: radio_sim [-f hz] [-m usb|lsb] [-b bw] [-a agc] [-v vol] [-g attn]\n"
+                  "                 [-t hz,dbm]... [-r hz,secs] [-s secs] [-o out.wav]\n"
+                  "                 [-N db] [-R ohm] [-C nf] [-G db] [-P deg] [-A db] [-q lsb]\n"
+                  "                 [-M] [-B hz] [-S lo,step,n[,dwell]]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int32_t vfo = 7074000;
+  int32_t retune = 0;
+  double retune_at = -1;
+  double length = 5;
+  double boff = 20000;
+  const char *outfile = NULL;
+  bool meas = false;
+  int32_t scan_lo = 0;
+  int scan_step = 0, scan_n = 0, scan_dwell = 0;
+  int ch;
+  int fails = 0;
+  while ((ch = getopt(argc, argv, "f:m:b:a:v:g:t:r:s:o:N:R:C:G:P:A:q:MB:S:h")) != -1) {
+    switch (ch) {
+      case 'f': vfo = atol(optarg); break;
+      case 'm': radiomode = strcmp(optarg, "lsb") ? USB : LSB; break;
+      case 'b': filterbw = atoi(optarg); break;
+      case 'a': agc = atoi(optarg); break;
+      case 'v': volume = atoi(optarg); break;
+      case 'g': dg_attn = atoi(optarg); break;
+      case 't': {
+        Tone t = { 0, -73 };
+        if (sscanf(optarg, "%lf,%lf", &t.hz, &t.dbm) < 1) usage();
+        tones.push_back(t);
+        break;
+      }
+      case 'r':
+        if (sscanf(optarg, "%d,%lf", &retune, &retune_at) != 2) usage();
+        break;
+      case 's': length = atof(optarg); break;
+      case 'o': outfile = optarg; break;
+      case 'N': nf = atof(optarg); break;
+      case 'R': rs = atof(optarg); break;
+      case 'C': cs = atof(optarg) * 1e-9; break;
+      case 'G': q_gain = atof(optarg); break;
+      case 'P': q_phase = atof(optarg); break;
+      case 'A': bb_gain = atof(optarg); break;
+      case 'q': adc_noise = atof(optarg); break;
+      case 'M': meas = true; break;
+      case 'B': boff = atof(optarg); break;
+      case 'S':
+        if (sscanf(optarg, "%d,%d,%d,%d", &scan_lo, &scan_step, &scan_n, &scan_dwell) < 3) usage();
+        break;
+      default: usage();
+    }
+  }
+  hal_adc_source = adc_source;
+  hal_dac_sink = dac_sink;
+  detector_init();
+  si5351.fxtal = F_XTAL;
+  si5351.iqmsa = 0;
+  tune(vfo);
+  lo_update();
+  printf("VFO %d Hz: LO %.3f Hz, CLK1-CLK0 %.2f deg, detector pole %.0f Hz, %u I2C bytes\n",
+         vfo, flo, si5351_model.phase(1) - si5351_model.phase(0), fc, si5351_model.bytes);
+
+  auto t0 = clk::now();
+  if (meas) {
+    metrics(vfo, boff);
+  } else if (scan_n) {
+    tones_update();
+    fails = scan_bench(scan_lo, scan_step, scan_n, scan_dwell, length);
+  } else {
+    if (tones.empty()) tones.push_back({ vfo + ((radiomode == USB) ? 1000.0 : -1000.0), -73 });
+    tones_update();
+    recv.begin();
+    if ((retune_at >= 0) && (retune_at < length)) {
+      run(retune_at);
+      uint32_t w = si5351_model.writes, b = si5351_model.bytes, r = si5351_model.pll_resets;
+      tune(retune);
+      lo_update();
+      printf("retune at %.3f s to %d Hz: LO %.3f Hz, %u writes, %u bytes, %u PLL resets\n",
+             retune_at, retune, flo, si5351_model.writes - w, si5351_model.bytes - b,
+             si5351_model.pll_resets - r);
+      run(length - retune_at);
+    } else {
+      run(length);
+    }
+    double pa = audio_power();
+    printf("output       %.1f dB re 1 PWM unit^2\n", db(pa));
+  }
+  double wall = std::chrono::duration<double>(clk::now() - t0).count();
+  double simulated = (double)sim_ticks / ADC_RATE;
+
+  if (outfile) {
+    WAV out;
+    out.rate = IQ_RATE;
+    out.channels = 1;
+    out.bits = 8;
+    out.data.assign(dac_out.begin(), dac_out.end());
+    if (!wav_write(outfile, out)) {
+      fprintf(stderr, "%s: write failed\n", outfile);
+      return 1;
+    }
+  }
+  printf("simulated %.2f s in %.2f s, %.0fx real time\n", simulated, wall, simulated / wall);
+  return fails ? 1 : 0;
+}
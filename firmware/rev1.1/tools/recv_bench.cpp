@@ -0,0 +1,219 @@
+
+// ============================================================================
+//
+// recv_bench.cpp   - stream I/Q through the RECV DSP chain on the host
+//
+// usage: recv_bench [options] [in.wav]
+//
+//   in.wav      16-bit stereo I/Q recording (I=left, Q=right) at 31250 Hz,
+//               the per-channel rate of the 62.5 kHz interleaved ADC
+//               (ADC_RATE/2 when built with another ADC_RATE)
+//   -o out.wav  write the PWM DAC output (8-bit unsigned, ADC_RATE/2)
+//   -m mode     usb | lsb | cw
+//   -b bw       filter bandwidth index (0=1500 1=2000 2=2500 3=FULL
+//               4=1000 5=CW500 6=CW300)
+//   -a agc      agc mode (0=OFF 1=FAST 2=SLOW 3=LOOK)
+//   -v vol      volume (5..12)
+//   -g attn     digital attenuation index (0..6)
+//   -t hz       no input file: synthesize a complex tone at hz
+//               (the sign of hz selects the sideband)
+//   -l level    peak level of the synthesized tone (default 8000)
+//   -s secs     length of the synthesized input (default 10)
+//   -r n        repeat the input n times (throughput runs)
+//   -k          step test: the synthesized tone jumps up 40 dB half way
+//               through; prints the AGC attack overshoot
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "hal_host.h"
+#include "recv.h"
+#include "wav.h"
+
+#define IQ_RATE   (ADC_RATE / 2)      // per-channel rate
+
+extern uint8_t radiomode, volume, filterbw, dg_attn, agc, rxstate;
+
+RECV recv;
+
+static const int16_t *iq;             // interleaved I/Q input
+static size_t iq_len, iq_pos;
+static std::vector<int16_t> dac_out;
+
+// ADC model: 16-bit sample to unsigned 10-bit
+static uint16_t adc_source(uint8_t pin) {
+  int16_t s = 0;
+  if (iq_pos + 1 < iq_len) {
+    s = (pin == QSDI) ? iq[iq_pos] : iq[iq_pos+1];
+    if (pin == QSDQ) iq_pos += 2;
+  }
+  return hal_adc10(s);
+}
+
+static void dac_sink(uint8_t val) {
+  dac_out.push_back(val);
+}
+
+typedef std::chrono::steady_clock clk;
+
+static double secs(clk::time_point t0) {
+  return std::chrono::duration<double>(clk::now() - t0).count();
+}
+
+static void usage() {
+  fprintf(stderr, "usage: recv_bench [-o out.wav] [-m usb|lsb|cw] [-b bw] [-a agc]\n"
+                  "                  [-v vol] [-g attn] [-t hz] [-l level] [-s secs] [-r n] [-k] [in.wav]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  const char *outfile = NULL;
+  double tone = 1000;
+  double level = 8000;
+  double length = 10;
+  int repeat = 1;
+  bool step = false;
+  int ch;
+  while ((ch = getopt(argc, argv, "o:m:b:a:v:g:t:l:s:r:kh")) != -1) {
+    switch (ch) {
+      case 'o': outfile = optarg; break;
+      case 'm':
+        if (!strcmp(optarg, "usb")) radiomode = USB;
+        else if (!strcmp(optarg, "lsb")) radiomode = LSB;
+        else if (!strcmp(optarg, "cw")) radiomode = CW;
+        else usage();
+        break;
+      case 'b': filterbw = atoi(optarg); break;
+      case 'a': agc = atoi(optarg); break;
+      case 'v': volume = atoi(optarg); break;
+      case 'g': dg_attn = atoi(optarg); break;
+      case 't': tone = atof(optarg); break;
+      case 'l': level = atof(optarg); break;
+      case 's': length = atof(optarg); break;
+      case 'r': repeat = atoi(optarg); break;
+      case 'k': step = true; break;
+      default: usage();
+    }
+  }
+
+  // load or synthesize the I/Q input
+  WAV in;
+  if (optind < argc) {
+    if (!wav_read(argv[optind], in) || (in.channels != 2) || (in.bits != 16)) {
+      fprintf(stderr, "%s: need a 16-bit stereo I/Q wav file\n", argv[optind]);
+      return 1;
+    }
+    if (in.rate != IQ_RATE) {
+      fprintf(stderr, "warning: %s is %u Hz, processed as %u Hz\n",
+              argv[optind], in.rate, IQ_RATE);
+    }
+  } else {
+    size_t n = length * IQ_RATE;
+    in.rate = IQ_RATE;
+    in.channels = 2;
+    in.bits = 16;
+    in.data.resize(2*n);
+    for (size_t k = 0; k < n; k++) {
+      double ph = 2 * M_PI * tone * k / IQ_RATE;
+      double a = (step && (k < n/2)) ? level / 100 : level;
+      in.data[2*k]   = a * cos(ph);
+      in.data[2*k+1] = a * sin(ph);
+    }
+  }
+  std::vector<int16_t> src;
+  for (int r = 0; r < repeat; r++) src.insert(src.end(), in.data.begin(), in.data.end());
+  iq = src.data();
+  iq_len = src.size();
+  iq_pos = 0;
+
+  hal_adc_source = adc_source;
+  hal_dac_sink = dac_sink;
+  recv.begin();
+  dac_out.reserve(iq_len / 2 + 16);
+
+  // full chain: one sample_dsp() call per ADC tick
+  size_t ticks = iq_len;
+  clk::time_point t0 = clk::now();
+  for (size_t k = 0; k < ticks; k++) {
+    recv.sample_dsp();
+#if DSP_MODE == DSP_BLOCK
+    recv.process_blocks();
+#endif
+  }
+  double t_chain = secs(t0);
+
+  if (outfile) {
+    WAV out;
+    out.rate = IQ_RATE;
+    out.channels = 1;
+    out.bits = 8;
+    out.data.assign(dac_out.begin(), dac_out.end());
+    if (!wav_write(outfile, out)) {
+      fprintf(stderr, "%s: write failed\n", outfile);
+      return 1;
+    }
+  }
+  hal_dac_sink = NULL;
+  printf("smeter       %d dBFS\n", recv.smeter());
+
+  // step test: peak output in the 100 ms after the step
+  // against the peak over the last quarter of the run
+  if (step) {
+    size_t n = dac_out.size();
+    size_t k0 = n / 2;
+    size_t k1 = k0 + IQ_RATE / 10;
+    int pk_step = 0, pk_end = 0;
+    for (size_t k = k0; (k < k1) && (k < n); k++) pk_step = max(pk_step, abs(dac_out[k] - 128));
+    for (size_t k = n - n/4; k < n; k++) pk_end = max(pk_end, abs(dac_out[k] - 128));
+    printf("step         peak %d  steady %d  overshoot %.1f dB\n",
+           pk_step, pk_end, 20 * log10((double)pk_step / max(pk_end, 1)));
+  }
+
+  // per-stage timing on the decimated rate
+  size_t nout = ticks / (2*DSP_DECIM);
+  std::vector<int16_t> vi(nout), vq(nout), va(nout);
+  for (size_t k = 0; k < nout; k++) {
+    vi[k] = src[2*DSP_DECIM*k] >> 2;
+    vq[k] = src[2*DSP_DECIM*k+1] >> 2;
+  }
+  volatile int16_t sink = 0;
+  t0 = clk::now();
+  for (size_t k = 0; k < nout; k++) va[k] = recv.hilb_i(vi[k]);
+  double t_hilb_i = secs(t0);
+  t0 = clk::now();
+  for (size_t k = 0; k < nout; k++) va[k] = -(va[k] - recv.hilb_q(vq[k]));
+  double t_hilb_q = secs(t0);
+  t0 = clk::now();
+  for (size_t k = 0; k < nout; k++) va[k] = recv.filter(va[k]);
+  double t_filter = secs(t0);
+  t0 = clk::now();
+  for (size_t k = 0; k < nout; k++) sink = recv.apply_agc(va[k]);
+  double t_agc = secs(t0);
+  t0 = clk::now();
+  for (size_t k = 0; k < ticks / 2; k++) recv.load_dac_audio();
+  double t_dac = secs(t0);
+  (void)sink;
+
+  double frames = ticks / 2.0;
+  printf("input        %.0f I/Q frames (%.2f s at %u Hz)\n", frames, frames / IQ_RATE, IQ_RATE);
+  printf("chain        %.3f s  %.3g frames/s  %.1fx realtime\n",
+         t_chain, frames / t_chain, frames / t_chain / IQ_RATE);
+  printf("per stage (ns per output sample, %zu samples)\n", nout);
+  printf("  hilb_i     %8.2f\n", 1e9 * t_hilb_i / nout);
+  printf("  hilb_q     %8.2f\n", 1e9 * t_hilb_q / nout);
+  printf("  filter     %8.2f\n", 1e9 * t_filter / nout);
+  printf("  apply_agc  %8.2f\n", 1e9 * t_agc / nout);
+  printf("  dac x%-6u%8.2f\n", DSP_DECIM, 1e9 * t_dac / nout);
+  printf("  chain      %8.2f\n", 1e9 * t_chain / nout);
+#if DSP_MODE == DSP_BLOCK
+  printf("block mode   %u underruns  %u overruns\n", recv.underruns, recv.overruns);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,294 @@
+
+// ============================================================================
+//
+// recv_simd.cpp   - host block kernels for RECV::process_block()
+//
+// The Hilbert Q transform and the bandwidth filter FIRs over a block of
+// samples, as plain C and with SSE2, AVX2 (x86-64) or NEON (ARM).  The
+// SIMD kernels compute 8 or 16 outputs per instruction and give the
+// same bits as the AVR code:
+//
+//   hilb_q   16-bit lanes: the sums wrap like the 16-bit AVR int, and
+//            the divisions round towards zero (bias negative values
+//            by 2^s-1, then shift)
+//   FIR      tap pairs widened to 32 bits and multiply-added (pmaddwd),
+//            FIRMac pairs folded in 16 bits first, the 32-bit sum
+//            shifted by gain and truncated to 16 bits
+//
+// blk_select() picks a set by name ("c", "sse2", "avx2", "neon"), or
+// the best one the CPU has for NULL or "auto".  RECV_SIMD in the
+// environment overrides the initial choice.
+//
+// ============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include "recv.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// ----------------------------------------------------------------------------
+// C
+// ----------------------------------------------------------------------------
+
+static void hilb_q_c(const int16_t *x, int16_t *y, uint16_t n) {
+  for (uint16_t t = 0; t < n; t++) {
+    const int16_t *v = x + t;   // v[13-k] is k samples ago
+    int16_t a = (v[0] - v[13]) + (v[2] - v[12]) * 4;
+    int16_t b = (v[4] - v[10]) + (v[6] - v[8]);
+    int16_t c = (v[4] - v[10]) * 5 - (v[6] - v[8]);
+    int16_t d = v[6] - v[8];
+    y[t] = a / 64 + b / 8 + c / 128 + d / 2;
+  }
+}
+
+static void fir_c(const int16_t *x, int16_t *y, uint16_t n, const int16_t *c, uint8_t m, bool fold16, uint8_t gain) {
+  for (uint16_t t = 0; t < n; t++) {
+    const int16_t *v = x + t;
+    uint32_t s = 0;   // wraps like the 32-bit AVR sum
+    for (uint8_t k = 0; k < m; k++) {
+      int32_t p = fold16 ? (int16_t)((uint16_t)v[k] + (uint16_t)v[2*m-k]) : (int32_t)v[k] + v[2*m-k];
+      s += (uint32_t)(p * c[k]);
+    }
+    s += (uint32_t)((int32_t)v[m] * c[m]);
+    y[t] = (int32_t)s >> gain;
+  }
+}
+
+static const blk_kernels_t blk_c = { "c", hilb_q_c, fir_c };
+
+// ----------------------------------------------------------------------------
+// SSE2 and AVX2
+// ----------------------------------------------------------------------------
+
+#ifdef HAVE_X86
+
+// x / 2^s rounded towards zero
+#define SSE_DIV(x, s)  _mm_srai_epi16(_mm_add_epi16(x, _mm_and_si128(_mm_srai_epi16(x, 15), _mm_set1_epi16((1 << (s)) - 1))), s)
+
+static void hilb_q_sse2(const int16_t *x, int16_t *y, uint16_t n) {
+  uint16_t t = 0;
+  for (; t + 8 <= n; t += 8) {
+    const int16_t *v = x + t;
+#define L(k)  _mm_loadu_si128((const __m128i *)(v + k))
+    __m128i e = _mm_sub_epi16(L(4), L(10));
+    __m128i d = _mm_sub_epi16(L(6), L(8));
+    __m128i a = _mm_add_epi16(_mm_sub_epi16(L(0), L(13)), _mm_slli_epi16(_mm_sub_epi16(L(2), L(12)), 2));
+    __m128i b = _mm_add_epi16(e, d);
+    __m128i c = _mm_sub_epi16(_mm_add_epi16(_mm_slli_epi16(e, 2), e), d);
+#undef L
+    __m128i r = _mm_add_epi16(_mm_add_epi16(SSE_DIV(a, 6), SSE_DIV(b, 3)), _mm_add_epi16(SSE_DIV(c, 7), SSE_DIV(d, 1)));
+    _mm_storeu_si128((__m128i *)(y + t), r);
+  }
+  hilb_q_c(x + t, y + t, n - t);
+}
+
+static void fir_sse2(const int16_t *x, int16_t *y, uint16_t n, const int16_t *c, uint8_t m, bool fold16, uint8_t gain) {
+  __m128i sh = _mm_cvtsi32_si128(gain);
+  uint16_t t = 0;
+  for (; t + 8 <= n; t += 8) {
+    const int16_t *v = x + t;
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    uint8_t k = 0;
+    if (fold16) {
+      // folded pairs k and k+1 with coefficients (c[k], c[k+1])
+      for (; k + 1 < m; k += 2) {
+        __m128i f0 = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(v + k)), _mm_loadu_si128((const __m128i *)(v + 2*m - k)));
+        __m128i f1 = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(v + k + 1)), _mm_loadu_si128((const __m128i *)(v + 2*m - k - 1)));
+        __m128i cc = _mm_set1_epi32((uint16_t)c[k] | ((uint32_t)(uint16_t)c[k+1] << 16));
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(f0, f1), cc));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(f0, f1), cc));
+      }
+      if (k < m) {
+        __m128i f0 = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(v + k)), _mm_loadu_si128((const __m128i *)(v + 2*m - k)));
+        __m128i f1 = _mm_loadu_si128((const __m128i *)(v + m));
+        __m128i cc = _mm_set1_epi32((uint16_t)c[k] | ((uint32_t)(uint16_t)c[m] << 16));
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(f0, f1), cc));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(f0, f1), cc));
+        k = m + 1;
+      }
+    } else {
+      // unfolded pair x[k], x[2m-k] with coefficients (c[k], c[k])
+      for (; k < m; k++) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(v + k));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + 2*m - k));
+        __m128i cc = _mm_set1_epi16(c[k]);
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), cc));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), cc));
+      }
+    }
+    if (k == m) {
+      // centre tap with a zero partner
+      __m128i a = _mm_loadu_si128((const __m128i *)(v + m));
+      __m128i cc = _mm_set1_epi32((uint16_t)c[m]);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, _mm_setzero_si128()), cc));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, _mm_setzero_si128()), cc));
+    }
+    // shift, keep the low 16 bits
+    lo = _mm_srai_epi32(_mm_slli_epi32(_mm_sra_epi32(lo, sh), 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(_mm_sra_epi32(hi, sh), 16), 16);
+    _mm_storeu_si128((__m128i *)(y + t), _mm_packs_epi32(lo, hi));
+  }
+  fir_c(x + t, y + t, n - t, c, m, fold16, gain);
+}
+
+static const blk_kernels_t blk_sse2 = { "sse2", hilb_q_sse2, fir_sse2 };
+
+// the AVX2 kernels are the SSE2 ones on 16 lanes; unpack and pack both
+// work within 128-bit halves, so the outputs come back in order
+#define AVX2  __attribute__((target("avx2")))
+#define AVX_DIV(x, s)  _mm256_srai_epi16(_mm256_add_epi16(x, _mm256_and_si256(_mm256_srai_epi16(x, 15), _mm256_set1_epi16((1 << (s)) - 1))), s)
+
+AVX2 static void hilb_q_avx2(const int16_t *x, int16_t *y, uint16_t n) {
+  uint16_t t = 0;
+  for (; t + 16 <= n; t += 16) {
+    const int16_t *v = x + t;
+#define L(k)  _mm256_loadu_si256((const __m256i *)(v + k))
+    __m256i e = _mm256_sub_epi16(L(4), L(10));
+    __m256i d = _mm256_sub_epi16(L(6), L(8));
+    __m256i a = _mm256_add_epi16(_mm256_sub_epi16(L(0), L(13)), _mm256_slli_epi16(_mm256_sub_epi16(L(2), L(12)), 2));
+    __m256i b = _mm256_add_epi16(e, d);
+    __m256i c = _mm256_sub_epi16(_mm256_add_epi16(_mm256_slli_epi16(e, 2), e), d);
+#undef L
+    __m256i r = _mm256_add_epi16(_mm256_add_epi16(AVX_DIV(a, 6), AVX_DIV(b, 3)), _mm256_add_epi16(AVX_DIV(c, 7), AVX_DIV(d, 1)));
+    _mm256_storeu_si256((__m256i *)(y + t), r);
+  }
+  hilb_q_sse2(x + t, y + t, n - t);
+}
+
+AVX2 static void fir_avx2(const int16_t *x, int16_t *y, uint16_t n, const int16_t *c, uint8_t m, bool fold16, uint8_t gain) {
+  __m128i sh = _mm_cvtsi32_si128(gain);
+  uint16_t t = 0;
+  for (; t + 16 <= n; t += 16) {
+    const int16_t *v = x + t;
+    __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+    uint8_t k = 0;
+#define L(k)  _mm256_loadu_si256((const __m256i *)(v + (k)))
+    if (fold16) {
+      for (; k + 1 < m; k += 2) {
+        __m256i f0 = _mm256_add_epi16(L(k), L(2*m - k));
+        __m256i f1 = _mm256_add_epi16(L(k + 1), L(2*m - k - 1));
+        __m256i cc = _mm256_set1_epi32((uint16_t)c[k] | ((uint32_t)(uint16_t)c[k+1] << 16));
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(f0, f1), cc));
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(f0, f1), cc));
+      }
+      if (k < m) {
+        __m256i f0 = _mm256_add_epi16(L(k), L(2*m - k));
+        __m256i f1 = L(m);
+        __m256i cc = _mm256_set1_epi32((uint16_t)c[k] | ((uint32_t)(uint16_t)c[m] << 16));
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(f0, f1), cc));
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(f0, f1), cc));
+        k = m + 1;
+      }
+    } else {
+      for (; k < m; k++) {
+        __m256i a = L(k);
+        __m256i b = L(2*m - k);
+        __m256i cc = _mm256_set1_epi16(c[k]);
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), cc));
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), cc));
+      }
+    }
+    if (k == m) {
+      __m256i a = L(m);
+      __m256i cc = _mm256_set1_epi32((uint16_t)c[m]);
+      lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, _mm256_setzero_si256()), cc));
+      hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, _mm256_setzero_si256()), cc));
+    }
+#undef L
+    lo = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_sra_epi32(lo, sh), 16), 16);
+    hi = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_sra_epi32(hi, sh), 16), 16);
+    _mm256_storeu_si256((__m256i *)(y + t), _mm256_packs_epi32(lo, hi));
+  }
+  fir_sse2(x + t, y + t, n - t, c, m, fold16, gain);
+}
+
+static const blk_kernels_t blk_avx2 = { "avx2", hilb_q_avx2, fir_avx2 };
+
+#endif
+
+// ----------------------------------------------------------------------------
+// NEON
+// ----------------------------------------------------------------------------
+
+#ifdef __ARM_NEON
+
+// x / 2^s rounded towards zero
+#define NEON_DIV(x, s)  vshrq_n_s16(vaddq_s16(x, vandq_s16(vshrq_n_s16(x, 15), vdupq_n_s16((1 << (s)) - 1))), s)
+
+static void hilb_q_neon(const int16_t *x, int16_t *y, uint16_t n) {
+  uint16_t t = 0;
+  for (; t + 8 <= n; t += 8) {
+    const int16_t *v = x + t;
+    int16x8_t e = vsubq_s16(vld1q_s16(v + 4), vld1q_s16(v + 10));
+    int16x8_t d = vsubq_s16(vld1q_s16(v + 6), vld1q_s16(v + 8));
+    int16x8_t a = vaddq_s16(vsubq_s16(vld1q_s16(v), vld1q_s16(v + 13)), vshlq_n_s16(vsubq_s16(vld1q_s16(v + 2), vld1q_s16(v + 12)), 2));
+    int16x8_t b = vaddq_s16(e, d);
+    int16x8_t c = vsubq_s16(vmulq_n_s16(e, 5), d);
+    int16x8_t r = vaddq_s16(vaddq_s16(NEON_DIV(a, 6), NEON_DIV(b, 3)), vaddq_s16(NEON_DIV(c, 7), NEON_DIV(d, 1)));
+    vst1q_s16(y + t, r);
+  }
+  hilb_q_c(x + t, y + t, n - t);
+}
+
+static void fir_neon(const int16_t *x, int16_t *y, uint16_t n, const int16_t *c, uint8_t m, bool fold16, uint8_t gain) {
+  int32x4_t sh = vdupq_n_s32(-gain);
+  uint16_t t = 0;
+  for (; t + 8 <= n; t += 8) {
+    const int16_t *v = x + t;
+    int32x4_t lo = vdupq_n_s32(0), hi = vdupq_n_s32(0);
+    for (uint8_t k = 0; k < m; k++) {
+      int16x8_t a = vld1q_s16(v + k);
+      int16x8_t b = vld1q_s16(v + 2*m - k);
+      if (fold16) {
+        a = vaddq_s16(a, b);
+      } else {
+        lo = vmlal_n_s16(lo, vget_low_s16(b), c[k]);
+        hi = vmlal_n_s16(hi, vget_high_s16(b), c[k]);
+      }
+      lo = vmlal_n_s16(lo, vget_low_s16(a), c[k]);
+      hi = vmlal_n_s16(hi, vget_high_s16(a), c[k]);
+    }
+    int16x8_t a = vld1q_s16(v + m);
+    lo = vmlal_n_s16(lo, vget_low_s16(a), c[m]);
+    hi = vmlal_n_s16(hi, vget_high_s16(a), c[m]);
+    // shift, keep the low 16 bits
+    vst1q_s16(y + t, vcombine_s16(vmovn_s32(vshlq_s32(lo, sh)), vmovn_s32(vshlq_s32(hi, sh))));
+  }
+  fir_c(x + t, y + t, n - t, c, m, fold16, gain);
+}
+
+static const blk_kernels_t blk_neon = { "neon", hilb_q_neon, fir_neon };
+
+#endif
+
+// ----------------------------------------------------------------------------
+// dispatch
+// ----------------------------------------------------------------------------
+
+const blk_kernels_t *blk_select(const char *name) {
+  bool any = !name || !strcmp(name, "auto");
+#ifdef HAVE_X86
+  __builtin_cpu_init();   // may run before the static constructors
+  if ((any || !strcmp(name, "avx2")) && __builtin_cpu_supports("avx2")) return &blk_avx2;
+  if (any || !strcmp(name, "sse2")) return &blk_sse2;
+#endif
+#ifdef __ARM_NEON
+  if (any || !strcmp(name, "neon")) return &blk_neon;
+#endif
+  if (any || !strcmp(name, "c")) return &blk_c;
+  return 0;
+}
+
+static const blk_kernels_t *blk_init() {
+  const blk_kernels_t *k = blk_select(getenv("RECV_SIMD"));
+  return k ? k : blk_select(0);
+}
+
+const blk_kernels_t *blk_kernels = blk_init();
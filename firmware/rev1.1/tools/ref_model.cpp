@@ -0,0 +1,541 @@
+
+// ============================================================================
+//
+// ref_model.cpp   - fixed-point receive chain against a double reference
+//
+// usage: ref_model [-m usb|lsb] [-a agc] [-d dacmode] [-l level] [-s secs]
+//                  [-c] [in.wav]
+//
+//   -m mode     usb | lsb (default usb)
+//   -a agc      agc mode (0=OFF 1=FAST 2=SLOW 3=LOOK, default 0)
+//   -d dacmode  DAC interpolator mode (0..5, default 0)
+//   -l level    peak level of the test signals (default 2000)
+//   -s secs     length of the SNR runs (default 2)
+//   -c          check: mark and fail on results outside the limits
+//   in.wav      also compare on a 16-bit stereo I/Q recording at the
+//               per-channel rate (I=left, Q=right)
+//
+// The reference is a double precision model of sample_dsp(): the CIC
+// decimators, the Hilbert pair, the
+// bandwidth filter (the coefficients from filters.h), the AGC in the log
+// domain, the volume shift and the DAC CIC interpolator, with no
+// rounding anywhere.  It is fed the same 10-bit ADC samples as RECV and
+// produces one PWM duty value per DAC load, so the two outputs line up
+// sample for sample.  For every filterbw this prints
+//
+//   SNR         fixed-point output against the reference in the audio
+//               band for a tone, a two-tone signal, noise and the
+//               recording (dB)
+//   rejection   wanted tone over its image at the output (dB)
+//   ripple      passband ripple of a tone sweep (dB), the passband
+//               being where the reference is within 3 dB of its peak
+//   stopband    worst attenuation of the sweep outside the points where
+//               the reference first falls 30 dB below its peak (dB)
+//   crc         checksum of the fixed-point tone output, for changes
+//               that should be bit-exact
+//
+// with the reference's own figures after the slash.  With the AGC on
+// only the SNR is measured.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <random>
+#include <vector>
+#include "hal_host.h"
+#include "recv.h"
+#include "filters.h"
+#include "wav.h"
+
+#define IQ_RATE   (ADC_RATE / 2.0)          // per-channel rate, DAC load rate
+#define AF_RATE   (IQ_RATE / DSP_DECIM)     // audio rate
+#define AF_SCALE  (AF_RATE / 7812.5)        // test tones scale with it
+#define MAX_LAG   64                        // output delay search (DSP_BLOCK)
+
+extern uint8_t radiomode, volume, filterbw, dg_attn, agc, dacmode, rxstate;
+
+RECV recv;
+
+// ----------------------------------------------------------------------------
+// double reference
+// ----------------------------------------------------------------------------
+
+// Decim<DSP_DECIM>: third order CIC stages, 2:1 each; the first stage
+// scales by 1/2, the middle ones by 1/8 and the last by 1
+struct RefDecim {
+  double v[8][3];
+
+  bool put(double &x, uint8_t n) {
+    const int ns = (int)log2(DSP_DECIM);
+    for (int k = 0; k < ns; k++) {
+      double *s = v[k];
+      double y = (x + (s[0] + s[1]) * 3 + s[2]) * ((k == ns - 1) ? 1 : (k == 0) ? 0.5 : 0.125);
+      s[2] = s[1];
+      s[1] = s[0];
+      s[0] = x;
+      if (!(n & 1)) return false;
+      x = y;
+      n >>= 1;
+    }
+    return true;
+  }
+};
+
+// hilb_q(): antisymmetric, h[k] for the sample k steps ago
+static const double hilb_h[14] = {
+  -1/64.0, -1/16.0, 0, -21/128.0, 0, -79/128.0, 0,
+  79/128.0, 0, 21/128.0, 0, 1/16.0, 0, 1/64.0
+};
+
+// agc_par[] in recv.cpp
+struct RefAgc {
+  int attack;       // envelope attack shift
+  double decay;     // decay per sample (1/4096 octave)
+  long hang;        // hang time (samples)
+};
+
+static const RefAgc ref_agc[] = {
+  { 0, 0, 0 },
+  { 2, 4 * 7812 / AUDIO_RATE, (long)AUDIO_RATE * 100 / 1000 },
+  { 4, 1 * 7812 / AUDIO_RATE, (long)AUDIO_RATE * 500 / 1000 },
+  { 1, 4 * 7812 / AUDIO_RATE, (long)AUDIO_RATE * 100 / 1000 }
+};
+
+// filterbw coefficient sets, as fir_bank[] in recv.cpp
+struct RefFir {
+  const int16_t *c;
+  int m;
+};
+
+static const RefFir ref_fir[] = {
+  { fir1500::coef, fir1500::M }, { fir2000::coef, fir2000::M },
+  { fir2500::coef, fir2500::M }, { firfull::coef, firfull::M },
+  { fir1000::coef, fir1000::M }, { fircw500::coef, fircw500::M },
+  { fircw300::coef, fircw300::M }
+};
+
+#define NFILTERS  (int)(sizeof(ref_fir) / sizeof(ref_fir[0]))
+
+struct Ref {
+  RefDecim idec, qdec;
+  double qout;
+  double iprev;                   // sample_corr()
+  double hq[14], hi[7];           // Hilbert delay lines
+  double fd[32];                  // filter delay line
+  double env;                     // agc envelope (1/4096 octave)
+  long hang;
+  double ac3;
+  double zd[3], zi[3], comb;      // DAC interpolator
+  std::vector<double> out;        // PWM duty
+
+  static void shift(double *d, int n, double x) {
+    memmove(d + 1, d, (n - 1) * sizeof(double));
+    d[0] = x;
+  }
+
+  int order() {
+    // the 3rd order modes run the 2nd order CIC above DSP_DECIM 4
+    return ((dacmode >= DAC_CIC3) && (dacmode <= DAC_CIC3NS2) && (DSP_DECIM == 4)) ? 3 : 2;
+  }
+
+  void dac_comb(double ac) {
+    double x = ac / 8;                // ac3 +/-1024: PWM full scale
+    double d1 = x - zd[0];
+    double d2 = d1 - zd[1];
+    zd[1] = d1;
+    zd[0] = x;
+    comb = d2;
+    if (order() == 3) {
+      comb = d2 - zd[2];
+      zd[2] = d2;
+    }
+  }
+
+  void dac_load() {
+    zi[0] += comb;
+    zi[1] += zi[0];
+    double v = zi[1];
+    if (order() == 3) v = zi[2] += zi[1];
+    out.push_back(128 + v / pow(DSP_DECIM, order()));
+  }
+
+  void agc_detect(double lvl) {
+    const RefAgc &p = ref_agc[(agc <= LOOK) ? agc : OFF];
+    double l = lvl * 256;
+    if (l > env) {
+      env += (l - env) / (1 << p.attack);
+      hang = p.hang;
+    } else if (hang) {
+      hang--;
+    } else if (env > p.decay) {
+      env -= p.decay;
+    }
+  }
+
+  static double level(double x) {
+    return (fabs(x) >= 1) ? 16 * log2(fabs(x)) : 0;
+  }
+
+  double agc_gain(double x) {
+    double g = 208 - env / 256;
+    g = fmin(fmax(g, -32), 96);
+    return fmin(fmax(x * pow(2, g / 16), -32767), 32767);
+  }
+
+  void process(double i, double q) {
+    uint8_t m = (agc <= LOOK) ? agc : OFF;
+    dac_comb(ac3);
+    i /= 4;
+    q /= 4;
+    if (m == LOOK) agc_detect(fmin(level(i) + 30 + 16 * dg_attn, 255));
+    shift(hq, 14, q);
+    shift(hi, 7, i);
+    double qh = 0;
+    for (int k = 0; k < 14; k++) qh += hilb_h[k] * hq[k];
+    double ih = hi[6];
+    double ac = (radiomode == USB) ? -(ih - qh) : -(ih + qh);
+    shift(fd, 32, ac);
+    if (filterbw < NFILTERS) {
+      const RefFir &f = ref_fir[filterbw];
+      ac = f.c[f.m] * fd[f.m];
+      for (int k = 0; k < f.m; k++) ac += f.c[k] * (fd[k] + fd[2*f.m - k]);
+      ac /= 1 << (11 - dg_attn);
+    }
+    if ((m == FAST) || (m == SLOW)) agc_detect(level(ac));
+    if (m != OFF) ac = agc_gain(ac);
+    ac /= 1 << (14 - volume);
+    ac3 = fmin(fmax(ac, -2048), 2047);
+  }
+
+  // one sample clock tick, x is the unbiased ADC sample
+  void tick(uint8_t s, double x) {
+    if (s & 1) {
+      dac_load();
+      if (qdec.put(x, s >> 1)) qout = x;
+    } else {
+      // sample_corr(): I averaged with the I sample before
+      double xi = (x + iprev) / 2;
+      iprev = x;
+      if (idec.put(xi, (s >> 1) - 1)) process(xi, qout);
+    }
+  }
+};
+
+static Ref ref;
+
+// ----------------------------------------------------------------------------
+// test signals
+// ----------------------------------------------------------------------------
+
+enum { SRC_TONE, SRC_TWO, SRC_NOISE, SRC_WAV };
+
+static int src;
+static double level = 2000;
+static double hz1, hz2;               // complex tone frequencies
+static size_t pos;
+static std::mt19937 rng;
+static std::normal_distribution<double> gauss;
+static WAV wav;
+static int16_t adc_i, adc_q;          // current pair, 10-bit
+
+static int16_t adc10(double s) {
+  return hal_adc10(lrint(fmin(fmax(s, -32768), 32767)));
+}
+
+// make the next I/Q pair
+static void source() {
+  double si = 0, sq = 0;
+  double t = pos / IQ_RATE;
+  double tq = t + 1.0 / ADC_RATE;     // converted one tick after si
+  switch (src) {
+    case SRC_TONE:
+      si = level * sin(2 * M_PI * hz1 * t);
+      sq = level * cos(2 * M_PI * hz1 * tq);
+      break;
+    case SRC_TWO:
+      si = level / 2 * (sin(2 * M_PI * hz1 * t) + sin(2 * M_PI * hz2 * t));
+      sq = level / 2 * (cos(2 * M_PI * hz1 * tq) + cos(2 * M_PI * hz2 * tq));
+      break;
+    case SRC_NOISE:
+      si = level / 3 * gauss(rng);
+      sq = level / 3 * gauss(rng);
+      break;
+    case SRC_WAV:
+      if (2 * pos + 1 < wav.data.size()) {
+        si = wav.data[2 * pos];
+        sq = wav.data[2 * pos + 1];
+      }
+      break;
+  }
+  adc_i = adc10(si);
+  adc_q = adc10(sq);
+  pos++;
+}
+
+// the I read starts a new pair
+static uint16_t adc_source(uint8_t pin) {
+  if (pin == QSDI) source();
+  return (pin == QSDI) ? adc_i : adc_q;
+}
+
+static std::vector<double> fix;       // fixed-point PWM duty
+
+static void dac_sink(uint8_t val) {
+  fix.push_back(val);
+}
+
+// run both chains for n pairs
+static void run(size_t n) {
+  pos = 0;
+  rng.seed(1);
+  fix.clear();
+  recv.begin();
+  ref.out.clear();    // the state carries over, as it does in RECV
+  int16_t conv = 511;   // the ADC returns the previous conversion
+  for (size_t k = 0; k < 2 * n; k++) {
+    uint8_t s = rxstate;
+    recv.sample_dsp();
+#if DSP_MODE == DSP_BLOCK
+    recv.process_blocks();
+#endif
+    ref.tick(s, conv - 511);
+    conv = (s & 1) ? adc_q : adc_i;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// measurements
+// ----------------------------------------------------------------------------
+
+// AC power of x[from..]
+static double power(const std::vector<double> &x, size_t from) {
+  double m = 0, p = 0;
+  for (size_t k = from; k < x.size(); k++) m += x[k];
+  m /= x.size() - from;
+  for (size_t k = from; k < x.size(); k++) p += (x[k] - m) * (x[k] - m);
+  return p / (x.size() - from);
+}
+
+// two passes of a DSP_DECIM point moving average: nulls at the audio
+// rate and its multiples, so the DAC images and the shaped noise
+// near the DAC Nyquist frequency are left out of the comparison
+static std::vector<double> audio(const std::vector<double> &x) {
+  std::vector<double> y = x;
+  for (int p = 0; p < 2; p++) {
+    double a = 0;
+    std::vector<double> t(y.size());
+    for (size_t k = 0; k < y.size(); k++) {
+      a += y[k] - ((k >= DSP_DECIM) ? y[k - DSP_DECIM] : 0);
+      t[k] = a / DSP_DECIM;
+    }
+    y.swap(t);
+  }
+  return y;
+}
+
+// fixed-point output against the reference in the audio band, best
+// delay (dB)
+static double snr(size_t from) {
+  std::vector<double> f = audio(fix), r = audio(ref.out);
+  double best = 1e30;
+  size_t n = r.size() - MAX_LAG;
+  for (size_t lag = 0; lag <= MAX_LAG; lag++) {
+    double m = 0, p = 0;
+    for (size_t k = from; k < n; k++) m += f[k + lag] - r[k];
+    m /= n - from;
+    for (size_t k = from; k < n; k++) {
+      double e = f[k + lag] - r[k] - m;
+      p += e * e;
+    }
+    best = fmin(best, p / (n - from));
+  }
+  return 10 * log10(power(r, from) / fmax(best, 1e-12));
+}
+
+// Hann windowed amplitude of x[from..] at hz
+static double amplitude(const std::vector<double> &x, size_t from, double hz) {
+  size_t n = x.size() - from;
+  double re = 0, im = 0, ws = 0;
+  for (size_t k = 0; k < n; k++) {
+    double w = 0.5 - 0.5 * cos(2 * M_PI * k / n);
+    double p = 2 * M_PI * hz * k / IQ_RATE;
+    re += w * x[from + k] * cos(p);
+    im += w * x[from + k] * sin(p);
+    ws += w;
+  }
+  return 2 * sqrt(re * re + im * im) / ws;
+}
+
+static double db(double a) {
+  return 20 * log10(fmax(a, 1e-9));
+}
+
+// FNV-1a over the fixed-point output
+static uint32_t crc(size_t from) {
+  uint32_t h = 2166136261u;
+  for (size_t k = from; k < fix.size(); k++) {
+    h ^= (uint8_t)fix[k];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// test tones per filterbw (Hz at the 7812.5 Hz audio rate)
+static const double tone_hz[][3] = {
+  { 900, 600, 1300 }, { 1100, 700, 1600 }, { 1300, 800, 2000 }, { 1500, 800, 2600 },
+  { 600, 400, 850 }, { 650, 550, 750 }, { 650, 600, 700 }
+};
+
+// limits for -c (dB): SNR and rejection minimum, ripple over and
+// stopband attenuation under the reference's own
+#define LIM_SNR      35     // tone and two-tone
+#define LIM_NOISE    20
+#define LIM_AGC      20     // any signal, agc on
+#define LIM_REJECT   30
+#define LIM_RIPPLE   0.5
+#define LIM_STOP     3
+
+static bool check;
+static int fails;
+
+static const char *mark(bool ok) {
+  if (ok || !check) return " ";
+  fails++;
+  return "*";
+}
+
+static void usage() {
+  fprintf(stderr, "usage: ref_model [-m usb|lsb] [-a agc] [-d dacmode] [-l level] [-s secs] [-c] [in.wav]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  double secs = 2;
+  int ch;
+  while ((ch = getopt(argc, argv, "m:a:d:l:s:ch")) != -1) {
+    switch (ch) {
+      case 'm': radiomode = strcmp(optarg, "lsb") ? USB : LSB; break;
+      case 'a': agc = atoi(optarg); break;
+      case 'd': dacmode = atoi(optarg); break;
+      case 'l': level = atof(optarg); break;
+      case 's': secs = atof(optarg); break;
+      case 'c': check = true; break;
+      default: usage();
+    }
+  }
+  bool have_wav = (optind < argc);
+  if (have_wav) {
+    if (!wav_read(argv[optind], wav) || (wav.channels != 2) || (wav.bits != 16)) {
+      fprintf(stderr, "%s: need a 16-bit stereo I/Q file\n", argv[optind]);
+      return 1;
+    }
+    if (wav.rate != (uint32_t)IQ_RATE) {
+      fprintf(stderr, "warning: %s is %u Hz, expected %.0f Hz\n", argv[optind], wav.rate, IQ_RATE);
+    }
+  }
+  hal_adc_source = adc_source;
+  hal_dac_sink = dac_sink;
+
+  // wanted sideband: positive input frequency for USB
+  double sb = (radiomode == USB) ? 1 : -1;
+  size_t n = secs * IQ_RATE, skip = n / 4;
+  size_t ns = 0.25 * IQ_RATE, sskip = ns / 4;   // sweep points
+
+  printf("%s  agc %u  dacmode %u  level %.0f  volume %u  dg_attn %u  audio %.1f Hz\n",
+         (radiomode == USB) ? "USB" : "LSB", agc, dacmode, level, volume, dg_attn, AF_RATE);
+  printf("bw   tone  SNR tone  2-tone  noise%s   rejection    ripple       stopband     crc\n",
+         have_wav ? "    wav " : "");
+  for (filterbw = 0; filterbw < NFILTERS; filterbw++) {
+    const char *names[] = { "1500", "2000", "2500", "FULL", "1000", "C500", "C300" };
+    double ft = tone_hz[filterbw][0] * AF_SCALE;
+    printf("%s %5.0f", names[filterbw], ft);
+
+    // SNR against the reference
+    double lsnr = (agc == OFF) ? LIM_SNR : LIM_AGC;
+    double lnoise = (agc == OFF) ? LIM_NOISE : LIM_AGC;
+    src = SRC_TONE;
+    hz1 = sb * ft;
+    run(n);
+    double s = snr(skip);
+    uint32_t c = crc(skip);
+    double wf = amplitude(fix, skip, ft), wr = amplitude(ref.out, skip, ft);
+    printf("  %6.1f%s", s, mark(s >= lsnr));
+    src = SRC_TWO;
+    hz1 = sb * tone_hz[filterbw][1] * AF_SCALE;
+    hz2 = sb * tone_hz[filterbw][2] * AF_SCALE;
+    run(n);
+    s = snr(skip);
+    printf(" %6.1f%s", s, mark(s >= lsnr));
+    src = SRC_NOISE;
+    run(n);
+    s = snr(skip);
+    printf(" %6.1f%s", s, mark(s >= lnoise));
+    if (have_wav) {
+      src = SRC_WAV;
+      run(wav.data.size() / 2);
+      printf(" %6.1f ", snr(min(skip, ref.out.size() / 4)));
+    }
+
+    // the response figures need a linear chain
+    if (agc != OFF) {
+      printf("        -             -            -      %08x\n", c);
+      continue;
+    }
+
+    // opposite sideband
+    src = SRC_TONE;
+    hz1 = -sb * ft;
+    run(n);
+    double rf = db(wf / amplitude(fix, skip, ft));
+    double rr = db(wr / amplitude(ref.out, skip, ft));
+    printf("  %5.1f%s/%5.1f", rf, mark(rf >= LIM_REJECT), rr);
+
+    // tone sweep
+    std::vector<double> sf, sr;
+    double top = -1e9;
+    for (double f = 100 * AF_SCALE; f < AF_RATE / 2 - 50 * AF_SCALE; f += 100 * AF_SCALE) {
+      hz1 = sb * f;
+      run(ns);
+      sf.push_back(db(amplitude(fix, sskip, f)));
+      sr.push_back(db(amplitude(ref.out, sskip, f)));
+      top = fmax(top, sr.back());
+    }
+    // passband: within 3 dB of the reference peak; stopband: outside the
+    // first points 30 dB down on either side of the peak
+    size_t kp = 0;
+    for (size_t k = 0; k < sr.size(); k++) if (sr[k] == top) kp = k;
+    long lo = -1, hi = sr.size();
+    for (long k = kp; k >= 0; k--) if (sr[k] <= top - 30) { lo = k; break; }
+    for (size_t k = kp; k < sr.size(); k++) if (sr[k] <= top - 30) { hi = k; break; }
+    double pf0 = 1e9, pf1 = -1e9, pr0 = 1e9, pr1 = -1e9, sf1 = -1e9, sr1 = -1e9;
+    for (long k = 0; k < (long)sr.size(); k++) {
+      if (sr[k] >= top - 3) {
+        pf0 = fmin(pf0, sf[k]);
+        pf1 = fmax(pf1, sf[k]);
+        pr0 = fmin(pr0, sr[k]);
+        pr1 = fmax(pr1, sr[k]);
+      }
+      if ((k < lo) || (k > hi)) {
+        sf1 = fmax(sf1, sf[k]);
+        sr1 = fmax(sr1, sr[k]);
+      }
+    }
+    double rip = pf1 - pf0;
+    printf("  %4.2f%s/%4.2f", rip, mark(rip <= pr1 - pr0 + LIM_RIPPLE), pr1 - pr0);
+    if (sf1 > -1e9) {
+      printf("  %5.1f%s/%5.1f", top - sf1, mark(top - sf1 >= top - sr1 - LIM_STOP), top - sr1);
+    } else {
+      printf("      -/  -   ");
+    }
+    printf("  %08x\n", c);
+  }
+  if (check && fails) {
+    printf("FAIL: %d results outside the limits (*)\n", fails);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,352 @@
+
+// ============================================================================
+//
+// retune_bench.cpp   - VFO retune cost, SI5351::freq() against freq_fast()
+//                      and the RIT path freq_pll()
+//
+// Host build (build/retune_bench):
+//
+//   retune_bench [-c] [-f hz] [-s step] [-n detents]
+//
+//   -c          check the band table and RIT instead
+//   -f hz       start frequency (default 3573, 7074, 14074, 21074 and
+//               28074 kHz)
+//   -s step     Hz per encoder detent (default 10, 100 and 1000)
+//   -n detents  detents up, then as many down (default 2000)
+//
+//   Band table check: for a range of fxadj, every Hz of every band is
+//   tuned with freq() and with freq_fast() from the band table
+//   (SI5351::plan()).  The registers sent, the PLL resets and the
+//   phase offset state must be the same, else a FAIL line and exit
+//   status 1.
+//
+//   RIT (both modes): the dial is tuned from the band table, then the
+//   RIT offset runs from -9999 to +9999 Hz in 10 Hz steps and toggles
+//   between 0 and every 1000 Hz, each one freq_pll().  Only the MSNA
+//   registers may change and there must be no PLL reset, else a FAIL
+//   line and exit status 1.  The latency of a RIT step is the bus time
+//   plus the CPU time of the AVR build.
+//
+//   Otherwise every detent is a retune, once with freq() and once
+//   with freq_fast() and the band table of the radio, written through
+//   the host I2C0 into the register model (si5351_model.h).  Per
+//   detent: I2C transactions, register bytes written by the driver and
+//   sent past the register shadow, PLL resets and the bus time at
+//   400 kHz, 9 bit times per byte with the address and register bytes
+//   plus start and stop.  The "unshadowed" row is freq() as the
+//   driver sent it before the register shadow: every SendRegister()
+//   call its own transaction, all bytes on the bus.  The model LO must
+//   be within one MSNA fraction step below the request (freq()
+//   truncates b) with CLK1-CLK0 at 90 degrees, else a FAIL line and
+//   exit status 1.
+//
+// AVR build, run under simavr (make retune-bench):
+//
+//   CPU cycles of freq(), freq_fast() in the +/-5 kHz window,
+//   freq_fast() from the band table, freq_fast() changing between 40
+//   and 80 m (the table is built again) and freq_pll() for a RIT step
+//   at 7074 kHz, with the I2C writes counted but not sent; the bus
+//   time is added from the bytes.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef __AVR__
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#endif
+#include "i2c0.h"
+#include "si5351.h"
+#include "bands.h"
+
+#define F_XTAL    27000000UL
+#define I2C_RATE  400000UL
+#define RIT_MAX   9999
+
+SI5351 si5351;
+
+// bus time of one write transaction of n register bytes (bit times)
+#define I2C_BITS(n)  (9 * ((uint32_t)(n) + 2) + 2)
+
+#ifdef __AVR__
+
+#include <Arduino.h>
+#include "sim.h"
+
+// I2C writes are counted, nothing is sent
+static uint16_t writes, bytes;
+static uint32_t bits;
+
+I2C0 i2c0;
+
+I2C0::I2C0() {
+}
+
+void I2C0::write(uint8_t addr, uint8_t reg, uint8_t data) {
+  writes++;
+  bytes++;
+  bits += I2C_BITS(1);
+}
+
+void I2C0::write(uint8_t addr, uint8_t reg, uint8_t *data, uint8_t n) {
+  writes++;
+  bytes += n;
+  bits += I2C_BITS(n);
+}
+
+// not called when tuning, but SI5351::ReadRegister() links against it
+uint8_t I2C0::read(uint8_t addr, uint8_t reg) {
+  return 0;
+}
+
+typedef void (*tune_t)(int32_t);
+
+static void tune_freq(int32_t hz) { si5351.freq(hz, 0, 90); }
+static void tune_fast(int32_t hz) { si5351.freq_fast(hz, 0, 90); }
+static void tune_pll(int32_t hz)  { si5351.freq_pll(hz); }
+// every other detent from 40 m to 80 m: a band change, the table is built again
+static void tune_band(int32_t hz) { si5351.freq_fast(((hz / 10) & 1) ? hz - 3501000 : hz, 0, 90); }
+
+// time n detents of step Hz, cycles per detent (timer1 counts 8 cycles)
+static void timed(const char *name, tune_t f, int32_t hz, int16_t step, uint8_t n) {
+  uint32_t cycles = 0;
+  writes = bytes = 0;
+  bits = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    hz += step;
+    uint16_t t0 = TCNT1;
+    f(hz);
+    uint16_t t1 = TCNT1;
+    cycles += 8 * (uint32_t)(uint16_t)(t1 - t0);
+  }
+  uint32_t cpu_us = cycles / n / (F_CPU / 1000000);
+  uint32_t bus_us = bits * 1000000 / I2C_RATE / n;
+  printf("%-12s %6lu cycles %5lu us  + %2u.%u writes %2u.%u bytes %5lu us bus = %5lu us\n", name,
+         cycles / n, cpu_us, writes / n, (writes * 10 / n) % 10, bytes / n, (bytes * 10 / n) % 10,
+         bus_us, cpu_us + bus_us);
+}
+
+int main() {
+  sim_console();
+  cli();
+  TCCR1A = 0;                 // timer1 normal mode
+  TCCR1B = (1 << CS11);       // clk/8
+
+  si5351.fxtal = F_XTAL;
+  si5351.iqmsa = 0;
+  si5351.freq(7074000, 0, 90);
+  printf("retune per 10 Hz detent at 7074 kHz\n");
+  timed("freq()", tune_freq, 7074000, 10, 20);
+  si5351.freq(7074000, 0, 90);
+  timed("window", tune_fast, 7074000, 10, 20);
+  si5351.plan(bandedge, NBANDS);
+  si5351.freq_fast(7074000, 0, 90);
+  timed("band table", tune_fast, 7074000, 10, 20);
+  timed("band change", tune_band, 7074000, 10, 20);
+  si5351.freq_fast(7074000, 0, 90);
+  timed("RIT", tune_pll, 7074000, 10, 20);
+
+  sim_exit();
+}
+
+#else
+
+#include "si5351_model.h"
+
+static int fails;
+
+enum { FREQ, FAST, PLL };   // SI5351 path under test
+
+struct tally_t {
+  uint32_t writes, req, bytes, resets, detents, table, full;
+  uint64_t bits;
+  uint32_t bits_max;
+  uint32_t req_writes;        // as the driver without the register shadow
+  uint64_t req_bits;
+  uint32_t req_bits_max;
+  double err_min;
+};
+
+// one retune, counted and checked against the model
+static void detent(SI5351 &s, int how, int32_t hz, tally_t &t) {
+  static const char *name[] = { "freq()", "freq_fast()", "freq_pll()" };
+  uint32_t w = si5351_model.writes, b = si5351_model.bytes, r = si5351_model.pll_resets;
+  uint32_t rq = s.req_bytes, rw = s.req_writes, sb = s.sent_bytes;
+  uint8_t reg[256];
+  memcpy(reg, si5351_model.reg, sizeof(reg));
+  bool in = (how == FAST) && (s.seg_find(hz) >= 0);
+  if (how == PLL) s.freq_pll(hz);
+  else if (how == FAST) s.freq_fast(hz, 0, 90);
+  else s.freq(hz, 0, 90);
+  // I2C_BITS() summed over the transactions
+  uint32_t nw = si5351_model.writes - w, nb = si5351_model.bytes - b;
+  uint32_t bits = 9 * (nb + 2 * nw) + 2 * nw;
+  if (s.sent_bytes - sb != nb) {
+    printf("  FAIL %d Hz: %u bytes counted, %u on the bus\n", hz, s.sent_bytes - sb, nb);
+    fails++;
+  }
+  t.writes += nw;
+  t.req += s.req_bytes - rq;
+  t.bytes += nb;
+  t.resets += si5351_model.pll_resets - r;
+  t.bits += bits;
+  if (bits > t.bits_max) t.bits_max = bits;
+  // each SendRegister() its own transaction, every byte sent
+  uint32_t rbits = 9 * (s.req_bytes - rq + 2 * (s.req_writes - rw)) + 2 * (s.req_writes - rw);
+  t.req_writes += s.req_writes - rw;
+  t.req_bits += rbits;
+  if (rbits > t.req_bits_max) t.req_bits_max = rbits;
+  if (in) t.table++;
+  else if (s.req_bytes - rq > 5) t.full++;   // the window path asks for 5 bytes
+  t.detents++;
+  if (how == PLL) {
+    // MSNA is registers 26..33
+    int a;
+    for (a = 0; a < 256; a++) {
+      if (((a < 26) || (a > 33)) && (reg[a] != si5351_model.reg[a])) break;
+    }
+    if ((a < 256) || (si5351_model.pll_resets != r)) {
+      printf("  FAIL freq_pll() %d Hz: %s\n", hz, (a < 256) ? "not only MSNA written" : "PLL reset");
+      fails++;
+    }
+  }
+
+  double lo = si5351_model.fout(0);
+  double err = lo - hz;
+  double res = F_XTAL / 65536.0 / si5351_model.div(0);   // one step of b
+  double dph = si5351_model.phase(1) - si5351_model.phase(0);
+  if ((err > 1e-6) || (err < -res - 1e-6) || (fabs(dph - 90) > 1e-6) ||
+      !si5351_model.enabled(0) || !si5351_model.enabled(1)) {
+    printf("  FAIL %s %d Hz: LO %.3f Hz, CLK1-CLK0 %.3f deg\n", name[how], hz, lo, dph);
+    fails++;
+  }
+  if (err < t.err_min) t.err_min = err;
+}
+
+static void report(const char *name, const tally_t &t) {
+  double n = t.detents;
+  printf("  %-12s %6.2f %7.2f %7.2f %7.0f %7.0f %7u %8.2f\n", name, t.writes / n, t.req / n, t.bytes / n,
+         t.bits / n * 1e6 / I2C_RATE, t.bits_max * 1e6 / I2C_RATE, t.resets, t.err_min);
+}
+
+// the same retunes sent as the driver did before the register shadow
+static void report_direct(const char *name, const tally_t &t) {
+  double n = t.detents;
+  printf("  %-12s %6.2f %7.2f %7.2f %7.0f %7.0f %7u %8.2f\n", name, t.req_writes / n, t.req / n, t.req / n,
+         t.req_bits / n * 1e6 / I2C_RATE, t.req_bits_max * 1e6 / I2C_RATE, t.resets, t.err_min);
+}
+
+static void sweep(int32_t f0, int16_t step, int n) {
+  printf("%d kHz, %d Hz detents, %d up and %d down\n", f0 / 1000, step, n, n);
+  printf("               writes     req    sent  bus us     max  resets   err Hz\n");
+  tally_t t[2];
+  for (int fast = 0; fast < 2; fast++) {
+    SI5351 s{};
+    s.fxtal = F_XTAL;
+    s.iqmsa = 0;
+    if (fast) s.plan(bandedge, NBANDS);
+    s.freq(f0, 0, 90);
+    t[fast] = tally_t();
+    int32_t hz = f0;
+    for (int k = 0; k < 2 * n; k++) {
+      hz += (k < n) ? step : -step;
+      detent(s, fast ? FAST : FREQ, hz, t[fast]);
+    }
+  }
+  report_direct("unshadowed", t[0]);
+  report("freq()", t[0]);
+  report("freq_fast()", t[1]);
+  printf("  freq_fast() %u band table, %u window, %u freq(); bytes sent of requested %.1f%% and %.1f%%\n",
+         t[1].table, t[1].detents - t[1].table - t[1].full, t[1].full,
+         100.0 * t[0].bytes / t[0].req, 100.0 * t[1].bytes / t[1].req);
+}
+
+// RIT on a dial f0 tuned from the band table: 10 Hz steps over the
+// whole offset range, then on/off toggles, all through freq_pll()
+static void rit(int32_t f0) {
+  SI5351 s{};
+  s.fxtal = F_XTAL;
+  s.iqmsa = 0;
+  s.plan(bandedge, NBANDS);
+  s.freq_fast(f0, 0, 90);
+  tally_t sw = tally_t(), tg = tally_t();
+  for (int32_t o = -RIT_MAX; o <= RIT_MAX; o += 10) detent(s, PLL, f0 + o, sw);
+  for (int32_t o = -RIT_MAX; o <= RIT_MAX; o += 1000) {
+    detent(s, PLL, f0 + o, tg);
+    detent(s, PLL, f0, tg);
+  }
+  printf("RIT at %d kHz\n", f0 / 1000);
+  printf("               writes     req    sent  bus us     max  resets   err Hz\n");
+  report("10 Hz steps", sw);
+  report("on/off", tg);
+}
+
+// every Hz of every band through the band table against freq()
+static void check_table() {
+  static const int32_t adj[] = { -6000, -2501, 0, 1234, 6000 };
+  for (int32_t x : adj) {
+    SI5351 ref{}, tab{};
+    ref.fxtal = tab.fxtal = F_XTAL - x;
+    tab.plan(bandedge, NBANDS);
+    uint32_t n = 0, bad = 0;
+    uint8_t most = 0;
+    for (int b = 0; b < NBANDS; b++) {
+      for (int32_t f = bandedge[2*b]; f <= bandedge[2*b+1]; f++) {
+        uint32_t r0 = si5351_model.pll_resets;
+        ref.freq(f, 0, 90);
+        uint32_t r1 = si5351_model.pll_resets;
+        tab.freq_fast(f, 0, 90);
+        uint32_t r2 = si5351_model.pll_resets;
+        bool in = tab.seg_find(f) >= 0;
+        if (tab.nseg > most) most = tab.nseg;
+        n++;
+        if (in && !memcmp(ref.shadow, tab.shadow, sizeof(ref.shadow)) &&
+            !memcmp(ref.sh_valid, tab.sh_valid, sizeof(ref.sh_valid)) &&
+            (ref.iqmsa == tab.iqmsa) && (r1 - r0 == r2 - r1)) continue;
+        if (bad++ < 10) printf("  FAIL fxadj %d, %d Hz: %s\n", x, f, in ? "registers differ" : "not in the table");
+      }
+    }
+    printf("  fxadj %+5d: up to %2u of %u segments, %u frequencies, %u differ\n", x, most, SI5351_SEGS, n, bad);
+    if (bad) fails++;
+  }
+}
+
+static void usage() {
+  fprintf(stderr, "usage: retune_bench [-c] [-f hz] [-s step] [-n detents]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  std::vector<int32_t> fs = { 3573000, 7074000, 14074000, 21074000, 28074000 };
+  std::vector<int16_t> steps = { 10, 100, 1000 };
+  int n = 2000;
+  bool check_only = false;
+  int ch;
+  while ((ch = getopt(argc, argv, "cf:s:n:h")) != -1) {
+    switch (ch) {
+      case 'c': check_only = true; break;
+      case 'f': fs = { atoi(optarg) }; break;
+      case 's': steps = { (int16_t)atoi(optarg) }; break;
+      case 'n': n = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (n < 1) usage();
+  si5351_model.fxtal = F_XTAL;
+  if (check_only) {
+    printf("band table against freq()\n");
+    check_table();
+    for (int32_t f : fs) rit(f);
+    return fails ? 1 : 0;
+  }
+  for (int32_t f : fs) {
+    for (int16_t s : steps) sweep(f, s, n);
+    rit(f);
+  }
+  return fails ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,80 @@
+
+// ============================================================================
+//
+// si5351_model.cpp   - Si5351A register model
+//
+// ============================================================================
+
+#include <string.h>
+#include "si5351_model.h"
+
+SI5351Model si5351_model;
+
+SI5351Model::SI5351Model() {
+  fxtal = 27000000;
+  clear();
+}
+
+// power-up state: outputs disabled and powered down
+void SI5351Model::clear() {
+  memset(reg, 0, sizeof(reg));
+  reg[3] = 0xff;
+  for (uint8_t n = 16; n < 24; n++) reg[n] = 0x80;
+  writes = bytes = pll_resets = 0;
+  seq++;
+}
+
+// one I2C write transaction: n bytes from register addr on
+void SI5351Model::write(uint8_t addr, const uint8_t *data, uint8_t n) {
+  writes++;
+  bytes += n;
+  for (uint8_t k = 0; k < n; k++) {
+    reg[(uint8_t)(addr + k)] = data[k];
+    if ((uint8_t)(addr + k) == 177) {
+      if (data[k] & 0xa0) pll_resets++;
+      reg[177] = 0;   // self clearing
+    }
+  }
+  seq++;
+}
+
+// a + b/c of the 8 divider registers at r (AN619 P1/P2/P3)
+static double ratio(const uint8_t *r) {
+  uint32_t p3 = ((uint32_t)(r[5] >> 4) << 16) | (r[0] << 8) | r[1];
+  uint32_t p1 = ((uint32_t)(r[2] & 3) << 16) | (r[3] << 8) | r[4];
+  uint32_t p2 = ((uint32_t)(r[5] & 15) << 16) | (r[6] << 8) | r[7];
+  if (!p3) return 0;
+  return (p1 + 512 + (double)p2 / p3) / 128;
+}
+
+double SI5351Model::pll(uint8_t p) {
+  return fxtal * ratio(&reg[26 + 8*p]);
+}
+
+double SI5351Model::div(uint8_t clk) {
+  const uint8_t *r = &reg[42 + 8*clk];
+  if ((r[2] & 0x0c) == 0x0c) return 4;   // MSx_DIVBY4
+  return ratio(r);
+}
+
+uint8_t SI5351Model::rdiv(uint8_t clk) {
+  return (reg[44 + 8*clk] >> 4) & 7;
+}
+
+bool SI5351Model::enabled(uint8_t clk) {
+  return !(reg[16 + clk] & 0x80) && !(reg[3] & (1 << clk));
+}
+
+double SI5351Model::fout(uint8_t clk) {
+  double d = div(clk);
+  if (!enabled(clk) || (d < 4)) return 0;
+  uint8_t p = (reg[16 + clk] >> 5) & 1;   // MSx_SRC
+  return pll(p) / d / (1 << rdiv(clk));
+}
+
+// the offset register counts quarter periods of the VCO
+double SI5351Model::phase(uint8_t clk) {
+  double d = div(clk);
+  if (d < 4) return 0;
+  return (reg[165 + clk] & 0x7f) * 90 / d / (1 << rdiv(clk));
+}
@@ -0,0 +1,41 @@
+
+// ============================================================================
+//
+// si5351_model.h   - Si5351A register model
+//
+// The host I2C0 (i2c0_host.cpp) writes the SI5351 register bursts into
+// this model.  It decodes the PLL feedback and output multisynth
+// dividers (AN619 P1/P2/P3 format), the R dividers, the clock control
+// and output enable registers and the phase offsets into the output
+// frequency and phase of CLK0..CLK2.  It also counts the I2C traffic.
+//
+// ============================================================================
+
+#ifndef SI5351_MODEL_H
+#define SI5351_MODEL_H
+
+#include <inttypes.h>
+
+struct SI5351Model {
+  double   fxtal;             // crystal (Hz)
+  uint8_t  reg[256];          // register file
+  uint32_t writes;            // I2C write transactions
+  uint32_t bytes;             // register bytes written
+  uint32_t pll_resets;        // PLL reset commands (reg 177)
+  uint32_t seq;               // bumped on every write
+
+  SI5351Model();
+  void clear();
+  void write(uint8_t addr, const uint8_t *data, uint8_t n);
+
+  double pll(uint8_t p);      // VCO of PLLA (0) or PLLB (1) (Hz)
+  double div(uint8_t clk);    // output multisynth divider
+  uint8_t rdiv(uint8_t clk);  // R divider (log2)
+  double fout(uint8_t clk);   // output frequency (Hz), 0 when off
+  double phase(uint8_t clk);  // phase offset at fout (degrees)
+  bool enabled(uint8_t clk);  // powered up and output enabled
+};
+
+extern SI5351Model si5351_model;
+
+#endif
@@ -0,0 +1,257 @@
+
+// ============================================================================
+//
+// si5351_sweep.cpp   - SI5351 tuning accuracy and cost against the
+//                      register model
+//
+// usage: si5351_sweep [-t impl] [-a step] [-q]
+//
+//   -t impl     tuning code: freq, fast (freq_fast() with the band
+//               table of the radio) or all (default)
+//   -a step     fxadj step of the calibration sweep (default 1)
+//   -q          quick: the band sweep at fxadj 0 only
+//
+// Every retune goes through the host I2C0 into the register model
+// (si5351_model.h), which gives the CLK0/CLK1 frequency and phase of
+// the registers as written.  Sweeps:
+//
+//   bands        every Hz from 10 kHz below to 10 kHz above each band,
+//                at fxadj -6000, 0 and +6000
+//   calibration  every fxadj from -6000 to +6000 at the band edges and
+//                band frequencies
+//   switches     every Hz within 10 kHz of the R divider switch at
+//                500 kHz and the divider formula switches at 3.5 MHz
+//                and 30 MHz
+//
+// The crystal of the model is the calibrated fxtal, so the LO error is
+// that of the divider arithmetic alone: freq() truncates the MSNA
+// fraction, so the LO must be at most one fraction step below the
+// request.  CLK1-CLK0 must be 90 degrees and both outputs on; with
+// the R divider (below 500 kHz) the phase is only reported.  A retune
+// from 3.5 to 30 MHz that fails prints a FAIL line (the first 10) and
+// the exit status is 1; outside that it is a LIMIT line (below about
+// 1.5 MHz the divider is over 127 and the 7-bit phase register cannot
+// hold 90 degrees).  Also reported: how often freq() bumps d by 2 and how often the
+// +/-5 kHz window still crosses an MSNA integer step after that, the
+// VCO and divider ranges, the I2C writes and bytes per retune, the PLL
+// resets and the host time per retune.
+//
+// A new tuning implementation goes into impls[].
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "i2c0.h"
+#include "si5351.h"
+#include "si5351_model.h"
+#include "bands.h"
+
+#define F_XTAL    27000000UL
+
+SI5351 si5351;
+
+struct impl_t {
+  const char *name;
+  void (*init)(SI5351 &s);      // after fxtal is set
+  void (*tune)(SI5351 &s, int32_t hz);
+};
+
+static void no_init(SI5351 &s) {
+}
+
+static void freq_tune(SI5351 &s, int32_t hz) {
+  s.freq(hz, 0, 90);
+}
+
+static void band_init(SI5351 &s) {
+  s.plan(bandedge, NBANDS);
+}
+
+static void fast_tune(SI5351 &s, int32_t hz) {
+  s.freq_fast(hz, 0, 90);
+}
+
+static const impl_t impls[] = {
+  { "freq", no_init, freq_tune },
+  { "fast", band_init, fast_tune }
+};
+
+static int fails;
+
+struct stats_t {
+  uint64_t n = 0;
+  uint32_t fail = 0;
+  uint32_t limit = 0;           // fails outside 3.5..30 MHz
+  double err_max = 0;           // largest |LO error| (Hz)
+  double step_max = 0;          // largest error in fraction steps
+  double ph_min = 1e9, ph_max = -1e9;        // CLK1-CLK0, no R divider
+  double phr_min = 1e9, phr_max = -1e9;      // with the R divider
+  uint64_t rdiv = 0;            // retunes with the R divider
+  uint64_t bump = 0;            // d += 2
+  uint64_t split = 0;           // window still split after d += 2
+  double vco_min = 1e12, vco_max = 0;
+  double div_min = 1e9, div_max = 0;
+  uint64_t writes = 0, bytes = 0;
+  uint32_t bytes_max = 0;
+  uint64_t resets = 0;
+  double secs = 0;
+};
+
+// one retune, checked against the model
+static void retune(SI5351 &s, const impl_t &im, int32_t hz, stats_t &st) {
+  uint32_t w = si5351_model.writes, b = si5351_model.bytes, r = si5351_model.pll_resets;
+  auto t0 = std::chrono::steady_clock::now();
+  im.tune(s, hz);
+  st.secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  st.n++;
+  st.writes += si5351_model.writes - w;
+  st.bytes += si5351_model.bytes - b;
+  st.bytes_max = max(st.bytes_max, si5351_model.bytes - b);
+  st.resets += si5351_model.pll_resets - r;
+
+  uint32_t fx = s.fxtal;
+  double d = si5351_model.div(0);
+  uint8_t rd = si5351_model.rdiv(0);
+  double lo = si5351_model.fout(0);
+  double err = lo - hz;
+  double step = fx / 65536.0 / d / (1 << rd);   // one step of the MSNA fraction
+  double ph = si5351_model.phase(1) - si5351_model.phase(0);
+  st.err_max = max(st.err_max, fabs(err));
+  st.step_max = max(st.step_max, -err / step);
+  st.vco_min = min(st.vco_min, si5351_model.pll(0));
+  st.vco_max = max(st.vco_max, si5351_model.pll(0));
+  st.div_min = min(st.div_min, d);
+  st.div_max = max(st.div_max, d);
+  if (rd) {
+    st.rdiv++;
+    st.phr_min = min(st.phr_min, ph);
+    st.phr_max = max(st.phr_max, ph);
+  } else {
+    st.ph_min = min(st.ph_min, ph);
+    st.ph_max = max(st.ph_max, ph);
+  }
+
+  // the divider freq() starts from, before d += 2
+  int64_t f = (int64_t)hz << rd;
+  uint32_t c = (f < 3500000) ? 7 : (f < 30000000) ? 16 : 32;
+  uint32_t d0 = c * fx / f;
+  d0 += d0 & 1;
+  if ((uint32_t)d == d0 + 2) st.bump++;
+  if (!rd && ((int64_t)d * (f - 5000) / fx != (int64_t)d * (f + 5000) / fx)) st.split++;
+
+  bool bad = (err > 1e-6) || (err < -step - 1e-6) || !si5351_model.enabled(0) || !si5351_model.enabled(1) ||
+             (!rd && (fabs(ph - 90) > 1e-9));
+  if (!bad) return;
+  bool hf = (hz >= 3500000) && (hz <= 30000000);
+  uint32_t &k = hf ? st.fail : st.limit;
+  if (k++ < 10) {
+    printf("    %s %s fxadj %d, %d Hz: LO %.3f Hz (step %.3f), CLK1-CLK0 %.4f deg\n", hf ? "FAIL" : "LIMIT",
+           im.name, (int)(F_XTAL - fx), hz, lo, step, ph);
+  }
+}
+
+static void report(const char *sweep, const impl_t &im, const stats_t &st) {
+  printf("  %s, %s: %lu retunes, %u FAIL, %u LIMIT\n", sweep, im.name, (unsigned long)st.n, st.fail, st.limit);
+  printf("    LO error       max %.3f Hz, %.3f fraction steps\n", st.err_max, st.step_max);
+  if (st.n > st.rdiv) printf("    CLK1-CLK0      %.6f .. %.6f deg\n", st.ph_min, st.ph_max);
+  if (st.rdiv) {
+    printf("    R divider      %lu retunes, CLK1-CLK0 %.4f .. %.4f deg\n", (unsigned long)st.rdiv,
+           st.phr_min, st.phr_max);
+  }
+  printf("    d += 2         %lu retunes, window still split in %lu\n", (unsigned long)st.bump,
+         (unsigned long)st.split);
+  printf("    VCO            %.3f .. %.3f MHz, divider %.0f .. %.0f\n", st.vco_min / 1e6, st.vco_max / 1e6,
+         st.div_min, st.div_max);
+  printf("    I2C            %.2f writes, %.2f bytes per retune (max %u), %lu PLL resets\n",
+         (double)st.writes / st.n, (double)st.bytes / st.n, st.bytes_max, (unsigned long)st.resets);
+  printf("    time           %.3f us per retune\n", 1e6 * st.secs / st.n);
+  if (st.fail) fails++;
+}
+
+// a fresh driver and model at a calibration offset
+static void start(SI5351 &s, const impl_t &im, int32_t fxadj) {
+  s = SI5351();
+  s.fxtal = F_XTAL - fxadj;
+  s.fxadj = fxadj;
+  s.iqmsa = 0;
+  si5351_model.clear();
+  si5351_model.fxtal = s.fxtal;
+  im.init(s);
+}
+
+static void band_sweep(const impl_t &im, bool quick) {
+  static const int32_t adj[] = { -6000, 0, 6000 };
+  stats_t st;
+  SI5351 s;
+  for (int32_t x : adj) {
+    if (quick && x) continue;
+    start(s, im, x);
+    for (int b = 0; b < NBANDS; b++) {
+      for (int32_t f = bandedge[2*b] - 10000; f <= bandedge[2*b+1] + 10000; f++) retune(s, im, f, st);
+    }
+  }
+  report("bands", im, st);
+}
+
+static void cal_sweep(const impl_t &im, int step) {
+  stats_t st;
+  SI5351 s;
+  for (int32_t x = -6000; x <= 6000; x += step) {
+    start(s, im, x);
+    for (int b = 0; b < NBANDS; b++) {
+      retune(s, im, bandedge[2*b], st);
+      retune(s, im, bandfreq[b], st);
+      retune(s, im, bandedge[2*b+1], st);
+    }
+  }
+  report("calibration", im, st);
+}
+
+static void switch_sweep(const impl_t &im) {
+  static const int32_t at[] = { 500000, 3500000, 30000000 };
+  stats_t st;
+  SI5351 s;
+  start(s, im, 0);
+  for (int32_t c : at) {
+    for (int32_t f = c - 10000; f <= c + 10000; f++) retune(s, im, f, st);
+  }
+  report("switches", im, st);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: si5351_sweep [-t freq|fast|all] [-a step] [-q]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  const char *which = "all";
+  int step = 1;
+  bool quick = false;
+  int ch;
+  while ((ch = getopt(argc, argv, "t:a:qh")) != -1) {
+    switch (ch) {
+      case 't': which = optarg; break;
+      case 'a': step = atoi(optarg); break;
+      case 'q': quick = true; break;
+      default: usage();
+    }
+  }
+  if (step < 1) usage();
+  int found = 0;
+  for (const impl_t &im : impls) {
+    if (strcmp(which, "all") && strcmp(which, im.name)) continue;
+    found++;
+    printf("%s\n", im.name);
+    band_sweep(im, quick);
+    cal_sweep(im, quick ? 100 : step);
+    switch_sweep(im);
+  }
+  if (!found) usage();
+  return fails ? 1 : 0;
+}
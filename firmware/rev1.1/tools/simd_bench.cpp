@@ -0,0 +1,296 @@
+
+// ============================================================================
+//
+// simd_bench.cpp   - check and time the host block kernels
+//
+// usage: simd_bench [-c] [-H hours] [-b bw] [-a agc] [-n block] [in.wav]
+//
+//   -c          parity checks only
+//   -H hours    length of the throughput runs (default 1)
+//   -b bw       filter bandwidth index for the throughput runs
+//               (default 6, CW300, the longest filter)
+//   -a agc      agc mode for the throughput runs (default 1, FAST)
+//   -n block    samples per process_block() call (default 1024)
+//   in.wav      16-bit stereo I/Q at the decimated I/Q rate, looped;
+//               default a synthesized tone in noise
+//
+// Parity: every kernel set against the AVR code it replaces, first on
+// random full range input, which overflows the 16-bit sums of hilb_q
+// and the 16-bit folds of FIRMac, then through the whole chain:
+// process_block() against process() per sample, for every mode, agc
+// mode and filter, from an overloaded input down to noise.  A mismatch
+// prints DIFF and the exit status is 1.
+//
+// Throughput: the kernels alone, then hours of I/Q through process()
+// per sample and through process_block() with each kernel set, in
+// million samples per second and hours of signal per second of run
+// time.  The outputs must be identical.
+//
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "recv.h"
+#include "filters.h"
+#include "wav.h"
+
+#define CH_RATE   ((double)ADC_RATE / 2 / DSP_DECIM)   // process() rate
+
+extern uint8_t radiomode, filterbw, dg_attn, agc;
+
+static const char *sets[] = { "c", "sse2", "avx2", "neon" };
+
+static int fails;
+
+typedef std::chrono::steady_clock clk;
+
+static double secs(clk::time_point t0) {
+  return std::chrono::duration<double>(clk::now() - t0).count();
+}
+
+static uint32_t rnd() {
+  static uint32_t s = 12345;
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+// ----------------------------------------------------------------------------
+// kernels against the AVR code
+// ----------------------------------------------------------------------------
+
+typedef int16_t (*fir_run_t)(const int16_t *, uint8_t);
+
+struct filt_t {
+  const char *name;
+  fir_run_t run;
+  const int16_t *coef;
+  uint8_t m;
+  bool fold16;
+};
+
+static const filt_t filts[] = {
+  { "1500", fir1500::run, fir1500::coef, fir1500::M, false },
+  { "2000", fir2000::run, fir2000::coef, fir2000::M, false },
+  { "2500", fir2500::run, fir2500::coef, fir2500::M, false },
+  { "FULL", firfull::run, firfull::coef, firfull::M, false },
+  { "1000", fir1000::run, fir1000::coef, fir1000::M, false },
+  { "CW500", fircw500::run, fircw500::coef, fircw500::M, true },
+  { "CW300", fircw300::run, fircw300::coef, fircw300::M, true }
+};
+
+#define NFILTS  (sizeof(filts) / sizeof(filts[0]))
+#define KN      1003   // odd, so the kernels run their tails
+
+static void check_kernels(const blk_kernels_t *ks) {
+  std::vector<int16_t> x(KN + 64), y(KN), r(KN);
+  for (int pass = 0; pass < 2; pass++) {
+    // full range, then the +/-4096 range of the receiver
+    for (auto &v : x) v = pass ? (int16_t)rnd() % 4097 : (int16_t)rnd();
+    RECV ref;
+    for (int k = 0; k < 13; k++) ref.hilb_q(x[k]);
+    for (int t = 0; t < KN; t++) r[t] = ref.hilb_q(x[t + 13]);
+    ks->hilb_q(x.data(), y.data(), KN);
+    if (memcmp(y.data(), r.data(), KN * sizeof(int16_t))) {
+      printf("  DIFF %s hilb_q, %s input\n", ks->name, pass ? "receiver" : "full range");
+      fails++;
+    }
+    for (auto &f : filts) {
+      for (uint8_t g = 0; g < 12; g++) {
+        // the AVR kernels take x[k] k samples ago
+        int16_t d[64];
+        for (int t = 0; t < KN; t++) {
+          for (int k = 0; k <= 2*f.m; k++) d[k] = x[t + 2*f.m - k];
+          r[t] = f.run(d, g);
+        }
+        ks->fir(x.data(), y.data(), KN, f.coef, f.m, f.fold16, g);
+        if (memcmp(y.data(), r.data(), KN * sizeof(int16_t))) {
+          printf("  DIFF %s fir %s gain %u, %s input\n", ks->name, f.name, g, pass ? "receiver" : "full range");
+          fails++;
+          break;
+        }
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// I/Q source
+// ----------------------------------------------------------------------------
+
+static std::vector<int16_t> src_i, src_q;   // one loop of input
+
+static void synth(double level) {
+  size_t n = 10 * CH_RATE;
+  src_i.resize(n);
+  src_q.resize(n);
+  for (size_t k = 0; k < n; k++) {
+    double p = 2 * M_PI * 700 * k / CH_RATE;
+    double g = (k % 20000 < 10000) ? 1 : 0.01;   // keying for the AGC
+    double ni = ((int)(rnd() % 2001) - 1000) * 0.2, nq = ((int)(rnd() % 2001) - 1000) * 0.2;
+    src_i[k] = min(max(lrint(level * g * cos(p) + ni), -32768), 32767);
+    src_q[k] = min(max(lrint(level * g * sin(p) + nq), -32768), 32767);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// whole chain
+// ----------------------------------------------------------------------------
+
+static uint32_t fnv(uint32_t h, const int16_t *x, size_t n) {
+  for (size_t k = 0; k < n; k++) h = (h ^ (uint16_t)x[k]) * 16777619;
+  return h;
+}
+
+// n samples through process() per sample (ks NULL) or process_block()
+static uint32_t run(RECV &r, const blk_kernels_t *ks, size_t n, uint16_t blk) {
+  std::vector<int16_t> out(blk);
+  uint32_t h = 2166136261u;
+  size_t pos = 0, len = src_i.size();
+  blk_kernels = ks;
+  while (n) {
+    uint16_t nb = min(min((size_t)blk, n), len - pos);
+    if (ks) {
+      r.process_block(&src_i[pos], &src_q[pos], out.data(), nb);
+    } else {
+      for (uint16_t k = 0; k < nb; k++) {
+        r.process(src_i[pos + k], src_q[pos + k]);
+        out[k] = r.get_audio();
+      }
+    }
+    h = fnv(h, out.data(), nb);
+    pos = (pos + nb) % len;
+    n -= nb;
+  }
+  return h;
+}
+
+static void check_chain(const blk_kernels_t *ks) {
+  static const double levels[] = { 30000, 8000, 500, 0 };
+  for (double l : levels) {
+    synth(l);
+    for (uint8_t m = 0; m < 2; m++) {
+      for (uint8_t a = 0; a < 4; a++) {
+        for (uint8_t b = 0; b < NFILTS + 1; b++) {
+          radiomode = m ? LSB : USB;
+          agc = a;
+          filterbw = b;   // NFILTS: no filter
+          RECV r1, r2;
+          r1.configure();
+          r2.configure();
+          // odd block lengths cross the kernel and ring boundaries
+          uint32_t h1 = run(r1, 0, 20000, 1);
+          uint32_t h2 = run(r2, ks, 20000, 77);
+          if ((h1 != h2) || (r1.smeter() != r2.smeter())) {
+            printf("  DIFF %s chain %s agc %u bw %u level %.0f\n", ks->name, m ? "lsb" : "usb", a, b, l);
+            fails++;
+          }
+        }
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+static void usage() {
+  fprintf(stderr, "usage: simd_bench [-c] [-H hours] [-b bw] [-a agc] [-n block] [in.wav]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  bool check_only = false;
+  double hours = 1;
+  uint8_t bw = 6, ag = 1;
+  int blk = 1024;
+  int ch;
+  while ((ch = getopt(argc, argv, "cH:b:a:n:h")) != -1) {
+    switch (ch) {
+      case 'c': check_only = true; break;
+      case 'H': hours = atof(optarg); break;
+      case 'b': bw = atoi(optarg); break;
+      case 'a': ag = atoi(optarg); break;
+      case 'n': blk = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if ((blk < 1) || (blk > 65535)) usage();
+
+  std::vector<const blk_kernels_t *> ks;
+  for (const char *s : sets) {
+    const blk_kernels_t *k = blk_select(s);
+    if (k && !strcmp(k->name, s)) ks.push_back(k);
+  }
+  printf("kernel sets:");
+  for (auto k : ks) printf(" %s", k->name);
+  printf(", auto %s\n", blk_select(0)->name);
+
+  printf("parity\n");
+  for (auto k : ks) {
+    int f = fails;
+    check_kernels(k);
+    check_chain(k);
+    printf("  %-5s %s\n", k->name, (fails == f) ? "ok" : "FAILED");
+  }
+  if (check_only) return fails ? 1 : 0;
+
+  if (optind < argc) {
+    WAV in;
+    if (!wav_read(argv[optind], in) || (in.channels != 2) || (in.bits != 16)) {
+      fprintf(stderr, "%s: need a 16-bit stereo I/Q wav file\n", argv[optind]);
+      return 1;
+    }
+    size_t n = in.data.size() / 2;
+    src_i.resize(n);
+    src_q.resize(n);
+    for (size_t k = 0; k < n; k++) {
+      src_i[k] = in.data[2*k];
+      src_q[k] = in.data[2*k+1];
+    }
+  } else {
+    synth(8000);
+  }
+
+  size_t n = hours * 3600 * CH_RATE;
+  const filt_t &f = filts[(bw < NFILTS) ? bw : NFILTS-1];
+  printf("kernels alone, Msps (%s filter)\n", f.name);
+  for (auto k : ks) {
+    std::vector<int16_t> x(blk + 64), y(blk);
+    for (int t = 0; t < blk; t++) x[t] = src_q[t % src_q.size()];
+    clk::time_point t = clk::now();
+    for (size_t d = 0; d < n; d += blk) k->hilb_q(x.data(), y.data(), blk);
+    double th = secs(t);
+    t = clk::now();
+    for (size_t d = 0; d < n; d += blk) k->fir(x.data(), y.data(), blk, f.coef, f.m, f.fold16, 7);
+    double tf = secs(t);
+    printf("  %-10s hilb_q %7.1f   fir %7.1f\n", k->name, n / th / 1e6, n / tf / 1e6);
+  }
+  radiomode = USB;
+  filterbw = bw;
+  agc = ag;
+  printf("throughput, %.2f h at %.1f Hz (%zu samples), bw %u agc %u, blocks of %d\n",
+         hours, CH_RATE, n, bw, ag, blk);
+  uint32_t h0 = 0;
+  double t0 = 0;
+  for (int s = -1; s < (int)ks.size(); s++) {
+    RECV r;
+    r.configure();
+    clk::time_point t = clk::now();
+    uint32_t h = run(r, (s < 0) ? 0 : ks[s], n, (s < 0) ? 1024 : blk);
+    double el = secs(t);
+    if (s < 0) {
+      h0 = h;
+      t0 = el;
+    }
+    printf("  %-10s %7.2f s  %7.1f Msps  %7.1f h/s  x%.2f%s\n", (s < 0) ? "process()" : ks[s]->name,
+           el, n / el / 1e6, hours / el, t0 / el, (h == h0) ? "" : "  DIFF");
+    if (h != h0) fails++;
+  }
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+
+// ============================================================================
+//
+// wav.cpp   - minimal RIFF/WAVE PCM reader and writer
+//
+// ============================================================================
+
+#include <string.h>
+#include "wav.h"
+
+static uint32_t rd32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static void wr32(FILE *f, uint32_t x) {
+  uint8_t b[4] = { (uint8_t)x, (uint8_t)(x>>8), (uint8_t)(x>>16), (uint8_t)(x>>24) };
+  fwrite(b, 1, 4, f);
+}
+
+static void wr16(FILE *f, uint16_t x) {
+  uint8_t b[2] = { (uint8_t)x, (uint8_t)(x>>8) };
+  fwrite(b, 1, 2, f);
+}
+
+// read a PCM wav file
+bool wav_read(const char *path, WAV &wav) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t hdr[12];
+  if ((fread(hdr, 1, 12, f) != 12) || memcmp(hdr, "RIFF", 4) || memcmp(hdr+8, "WAVE", 4)) {
+    fclose(f);
+    return false;
+  }
+  bool fmt = false;
+  uint8_t ck[8];
+  while (fread(ck, 1, 8, f) == 8) {
+    uint32_t len = rd32(ck+4);
+    if (!memcmp(ck, "fmt ", 4)) {
+      uint8_t b[16];
+      if ((len < 16) || (fread(b, 1, 16, f) != 16)) break;
+      if (rd16(b) != 1) break;     // PCM only
+      wav.channels = rd16(b+2);
+      wav.rate = rd32(b+4);
+      wav.bits = rd16(b+14);
+      if ((wav.bits != 8) && (wav.bits != 16)) break;
+      fseek(f, len - 16 + (len & 1), SEEK_CUR);
+      fmt = true;
+    } else if (!memcmp(ck, "data", 4) && fmt) {
+      uint32_t n = len / (wav.bits / 8);
+      wav.data.resize(n);
+      if (wav.bits == 16) {
+        std::vector<uint8_t> raw(len);
+        n = fread(raw.data(), 1, len, f) / 2;
+        for (uint32_t i = 0; i < n; i++) wav.data[i] = (int16_t)rd16(&raw[i*2]);
+      } else {
+        std::vector<uint8_t> raw(len);
+        n = fread(raw.data(), 1, len, f);
+        for (uint32_t i = 0; i < n; i++) wav.data[i] = raw[i];
+      }
+      wav.data.resize(n);
+      fclose(f);
+      return true;
+    } else {
+      fseek(f, len + (len & 1), SEEK_CUR);
+    }
+  }
+  fclose(f);
+  return false;
+}
+
+// write a PCM wav file
+bool wav_write(const char *path, const WAV &wav) {
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  uint32_t bps = wav.bits / 8;
+  uint32_t len = wav.data.size() * bps;
+  fwrite("RIFF", 1, 4, f);
+  wr32(f, 36 + len);
+  fwrite("WAVEfmt ", 1, 8, f);
+  wr32(f, 16);
+  wr16(f, 1);
+  wr16(f, wav.channels);
+  wr32(f, wav.rate);
+  wr32(f, wav.rate * wav.channels * bps);
+  wr16(f, wav.channels * bps);
+  wr16(f, wav.bits);
+  fwrite("data", 1, 4, f);
+  wr32(f, len);
+  for (size_t i = 0; i < wav.data.size(); i++) {
+    if (bps == 2) wr16(f, (uint16_t)wav.data[i]);
+    else fputc((uint8_t)wav.data[i], f);
+  }
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
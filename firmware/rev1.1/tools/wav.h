@@ -0,0 +1,26 @@
+
+// ============================================================================
+//
+// wav.h   - minimal RIFF/WAVE PCM reader and writer
+//
+// ============================================================================
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <vector>
+
+struct WAV {
+  uint32_t rate;                 // sample rate
+  uint16_t channels;             // number of channels
+  uint16_t bits;                 // 8 or 16
+  std::vector<int16_t> data;     // interleaved samples (8-bit data is
+                                 // stored unsigned 0..255)
+};
+
+bool wav_read(const char *path, WAV &wav);
+bool wav_write(const char *path, const WAV &wav);
+
+#endif